@@ -35,6 +35,14 @@ To use all the EasyQtSql features just include this header file into your projec
 */
 
 #include <QtSql>
+#include <functional>
+#include <tuple>
+#include <iterator>
+#include <exception>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
 
 /*!
    \brief Easy SQL data access helper for QtSql
@@ -58,22 +66,44 @@ namespace EasyQtSql
 #define EASY_QT_SQL_MAIN
 /// \endcond
 
-//SqlFactory (DB connection manager)
-#include "EasyQtSql_SqlFactory.h"
-
 //Generic classes
 #include "EasyQtSql_DBException.h"
 #include "EasyQtSql_ParamDirectionWrapper.h"
+#include "EasyQtSql_SqlDialect.h"
+
+//Connection and pool metrics
+#include "EasyQtSql_Metrics.h"
+
+//Prepared statements cache
+#include "EasyQtSql_StatementCache.h"
+
+//SqlFactory (DB connection manager)
+#include "EasyQtSql_SqlFactory.h"
 
 //Select query and query results
+#include "EasyQtSql_ValueConverter.h"
+#include "EasyQtSql_ColumnBatch.h"
 #include "EasyQtSql_NonQueryResult.h"
 #include "EasyQtSql_QueryResult.h"
 #include "EasyQtSql_PreparedQuery.h"
 
+//Aggregation over columnar batches
+#include "EasyQtSql_Aggregate.h"
+
+//Background prefetch of large result sets
+#include "EasyQtSql_PrefetchResult.h"
+
+//Keyset (seek) pagination
+#include "EasyQtSql_KeysetPaginator.h"
+
 //Insert/Update/Delete (CUD) operations
 #include "EasyQtSql_InsertQuery.h"
 #include "EasyQtSql_UpdateQuery.h"
 #include "EasyQtSql_DeleteQuery.h"
+#include "EasyQtSql_UpsertQuery.h"
+
+//Streaming insert with bounded memory
+#include "EasyQtSql_InsertStream.h"
 
 //Transaction helper
 #include "EasyQtSql_Transaction.h"
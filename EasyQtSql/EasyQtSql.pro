@@ -20,7 +20,17 @@ HEADERS += \
     EasyQtSql_ParamDirectionWrapper.h \
     EasyQtSql_UpdateQuery.h \
     EasyQtSql_SqlFactory.h \
-    EasyQtSql_Util.h
+    EasyQtSql_Util.h \
+    EasyQtSql_StatementCache.h \
+    EasyQtSql_Metrics.h \
+    EasyQtSql_ValueConverter.h \
+    EasyQtSql_ColumnBatch.h \
+    EasyQtSql_Aggregate.h \
+    EasyQtSql_PrefetchResult.h \
+    EasyQtSql_KeysetPaginator.h \
+    EasyQtSql_InsertStream.h \
+    EasyQtSql_UpsertQuery.h \
+    EasyQtSql_SqlDialect.h
 
 DISTFILES += \
     EasyQtSql.pri
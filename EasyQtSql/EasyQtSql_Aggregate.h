@@ -0,0 +1,573 @@
+#ifndef EASYQTSQL_AGGREGATE_H
+#define EASYQTSQL_AGGREGATE_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtCore>
+#include "EasyQtSql_ValueConverter.h"
+#include "EasyQtSql_ColumnBatch.h"
+
+#endif
+
+/*!
+\brief Aggregation kernels over columnar batches (see QueryResult::fetchColumns).
+
+The kernels read the typed column buffers directly and skip SQL NULL values with the column null bitmap:
+blocks of 64 rows without NULL values are processed with branch-free loops the compiler can vectorize.
+
+Accumulators (Aggregate::Stats, Aggregate::CountDistinct, Aggregate::GroupBy) can be fed with any number of batches,
+so the whole result set does not have to be kept in memory.
+
+\code
+QueryResult res = t.execQuery("SELECT category, price FROM goods");
+
+ColumnBatch batch;
+Aggregate::Stats total;
+Aggregate::GroupBy<QString> byCategory;
+
+while (res.fetchColumns(batch, 10000) > 0)
+{
+   total.add(batch.column(1));
+   byCategory.add(batch.column(0), batch.column(1));
+}
+
+qDebug() << total.sum() << total.min() << total.max() << total.mean();
+
+for (auto it = byCategory.groups().begin(); it != byCategory.groups().end(); ++it)
+{
+   qDebug() << it.key() << it.value().sum();
+}
+\endcode
+*/
+class Aggregate
+{
+public:
+
+   /*!
+   \brief Count, sum, min, max and mean of non-NULL numeric values.
+
+   ColumnBatch::Int64 and ColumnBatch::Double columns are aggregated by the kernels,
+   values of other columns are converted with QVariant::toDouble().
+   */
+   class Stats
+   {
+   public:
+      Stats()
+       : m_count(0)
+       , m_nullCount(0)
+       , m_sum(0)
+       , m_min(0)
+       , m_max(0)
+      { }
+
+      /*!
+      \brief Adds all values of column
+      */
+      void add(const ColumnBatch::Column &column)
+      {
+         switch (column.type())
+         {
+         case ColumnBatch::Int64:
+            accumulate<qint64, qint64>(column.int64Values().constData(), column.nullBitmap().constData(), column.count());
+            break;
+         case ColumnBatch::Double:
+            accumulate<double, double>(column.doubleValues().constData(), column.nullBitmap().constData(), column.count());
+            break;
+         default:
+            for (int i = 0; i < column.count(); ++i)
+            {
+               if (column.isNull(i))
+                  ++m_nullCount;
+               else
+                  addValue(column.value(i).toDouble());
+            }
+            break;
+         }
+      }
+
+      /*!
+      \brief Adds single value
+      */
+      void addValue(double value)
+      {
+         if (m_count == 0)
+         {
+            m_min = value;
+            m_max = value;
+         }
+         else
+         {
+            m_min = value < m_min ? value : m_min;
+            m_max = value > m_max ? value : m_max;
+         }
+
+         m_sum += value;
+         ++m_count;
+      }
+
+      /*!
+      \brief Adds SQL NULL value (counted with nullCount() only)
+      */
+      void addNull()
+      {
+         ++m_nullCount;
+      }
+
+      /*!
+      \brief Adds values aggregated by other
+      */
+      void merge(const Stats &other)
+      {
+         if (other.m_count > 0)
+         {
+            if (m_count == 0)
+            {
+               m_min = other.m_min;
+               m_max = other.m_max;
+            }
+            else
+            {
+               m_min = qMin(m_min, other.m_min);
+               m_max = qMax(m_max, other.m_max);
+            }
+         }
+
+         m_count += other.m_count;
+         m_nullCount += other.m_nullCount;
+         m_sum += other.m_sum;
+      }
+
+      /*!
+      \brief Returns count of non-NULL values (SQL COUNT(column))
+      */
+      qint64 count() const
+      {
+         return m_count;
+      }
+
+      /*!
+      \brief Returns count of NULL values
+      */
+      qint64 nullCount() const
+      {
+         return m_nullCount;
+      }
+
+      /*!
+      \brief Returns count of all values (SQL COUNT(*))
+      */
+      qint64 rowCount() const
+      {
+         return m_count + m_nullCount;
+      }
+
+      /*!
+      \brief Returns sum of non-NULL values
+      */
+      double sum() const
+      {
+         return m_sum;
+      }
+
+      /*!
+      \brief Returns min of non-NULL values or NaN if there are no values
+      */
+      double min() const
+      {
+         return m_count > 0 ? m_min : qQNaN();
+      }
+
+      /*!
+      \brief Returns max of non-NULL values or NaN if there are no values
+      */
+      double max() const
+      {
+         return m_count > 0 ? m_max : qQNaN();
+      }
+
+      /*!
+      \brief Returns mean of non-NULL values or NaN if there are no values
+      */
+      double mean() const
+      {
+         return m_count > 0 ? m_sum / m_count : qQNaN();
+      }
+
+   private:
+      template<typename T, typename Sum>
+      void accumulate(const T *values, const quint64 *nulls, int count)
+      {
+         for (int begin = 0; begin < count; begin += 64)
+         {
+            const int end = qMin(count, begin + 64);
+            const quint64 nullWord = nulls[begin >> 6];
+
+            if (nullWord == 0)
+            {
+               //no NULL values in the block: four independent accumulators, no branches
+               Sum sum[4] = {0, 0, 0, 0};
+               T minValue = values[begin];
+               T maxValue = values[begin];
+
+               int i = begin;
+
+               for (; i + 4 <= end; i += 4)
+               {
+                  sum[0] += values[i];
+                  sum[1] += values[i + 1];
+                  sum[2] += values[i + 2];
+                  sum[3] += values[i + 3];
+               }
+
+               for (; i < end; ++i)
+               {
+                  sum[0] += values[i];
+               }
+
+               for (i = begin; i < end; ++i)
+               {
+                  minValue = values[i] < minValue ? values[i] : minValue;
+                  maxValue = values[i] > maxValue ? values[i] : maxValue;
+               }
+
+               addBlock(double((sum[0] + sum[1]) + (sum[2] + sum[3])), double(minValue), double(maxValue), end - begin);
+            }
+            else
+            {
+               for (int i = begin; i < end; ++i)
+               {
+                  if ((nullWord >> (i & 63)) & 1)
+                     ++m_nullCount;
+                  else
+                     addValue(double(values[i]));
+               }
+            }
+         }
+      }
+
+      void addBlock(double sum, double minValue, double maxValue, int count)
+      {
+         if (m_count == 0)
+         {
+            m_min = minValue;
+            m_max = maxValue;
+         }
+         else
+         {
+            m_min = qMin(m_min, minValue);
+            m_max = qMax(m_max, maxValue);
+         }
+
+         m_sum += sum;
+         m_count += count;
+      }
+
+      qint64 m_count;
+      qint64 m_nullCount;
+      double m_sum;
+      double m_min;
+      double m_max;
+   };
+
+   /*!
+   \brief Count of distinct non-NULL values (SQL COUNT(DISTINCT column)).
+
+   Values are compared in a canonical form independent of the column type of the batch: whole numbers as integers,
+   other floating point numbers as doubles, values of other types as strings. So 1 of a ColumnBatch::Int64 batch, 1.0 of
+   a ColumnBatch::Double batch and 1 of a ColumnBatch::Variant batch are the same value.
+   */
+   class CountDistinct
+   {
+   public:
+      /*!
+      \brief Adds all values of column
+      */
+      void add(const ColumnBatch::Column &column)
+      {
+         const int count = column.count();
+
+         switch (column.type())
+         {
+         case ColumnBatch::Int64:
+         {
+            const qint64 *values = column.int64Values().constData();
+
+            for (int i = 0; i < count; ++i)
+            {
+               if (!column.isNull(i))
+                  m_int64Values.insert(values[i]);
+            }
+            break;
+         }
+         case ColumnBatch::Double:
+         {
+            const double *values = column.doubleValues().constData();
+
+            for (int i = 0; i < count; ++i)
+            {
+               if (!column.isNull(i))
+                  addDouble(values[i]);
+            }
+            break;
+         }
+         case ColumnBatch::String:
+            for (int i = 0; i < count; ++i)
+            {
+               if (!column.isNull(i))
+                  m_stringValues.insert(column.string(i));
+            }
+            break;
+         default:
+            for (int i = 0; i < count; ++i)
+            {
+               if (!column.isNull(i))
+                  addVariant(column.value(i));
+            }
+            break;
+         }
+      }
+
+      /*!
+      \brief Returns count of distinct values added
+      */
+      qint64 count() const
+      {
+         return qint64(m_int64Values.count()) + m_doubleValues.count() + m_stringValues.count();
+      }
+
+   private:
+      void addDouble(double value)
+      {
+         qint64 number = 0;
+
+         if (toInt64(value, number))
+            m_int64Values.insert(number);
+         else
+            m_doubleValues.insert(value);
+      }
+
+      void addVariant(const QVariant &value)
+      {
+         switch (ColumnBatch::columnType(value.type()))
+         {
+         case ColumnBatch::Int64:
+            m_int64Values.insert(value.toLongLong());
+            break;
+         case ColumnBatch::Double:
+            addDouble(value.toDouble());
+            break;
+         default:
+            m_stringValues.insert(value.toString());
+            break;
+         }
+      }
+
+      QSet<qint64>  m_int64Values;
+      QSet<double>  m_doubleValues;
+      QSet<QString> m_stringValues;
+   };
+
+   /*!
+   \brief Hash group-by: Aggregate::Stats of value column per distinct key column value.
+
+   Key type is qint64, double, QString or any type supported by ValueConverter and qHash.
+   Rows with SQL NULL key are aggregated in GroupBy::nullGroup, rows whose key does not convert to qint64 or double
+   without loss (e.g. 2.5 or a text key of GroupBy<qint64>) are aggregated in GroupBy::invalidKeyGroup.
+   */
+   template<typename Key>
+   class GroupBy
+   {
+   public:
+      /*!
+      \brief Adds rows of keys and values columns (columns of the same batch)
+      */
+      void add(const ColumnBatch::Column &keys, const ColumnBatch::Column &values)
+      {
+         const int count = qMin(keys.count(), values.count());
+
+         Key key = Key();
+         Stats *stats = nullptr;
+         bool grouped = false; //stats is the group of key
+
+         for (int i = 0; i < count; ++i)
+         {
+            if (keys.isNull(i))
+            {
+               stats = &m_nullGroup;
+               grouped = false;
+            }
+            else
+            {
+               const Key prevKey = key;
+
+               if (!keyAt(keys, i, key))
+               {
+                  stats = &m_invalidKeyGroup;
+                  grouped = false;
+               }
+               else if (!grouped || !(prevKey == key)) //sorted or clustered keys: skip the hash lookup for repeated keys
+               {
+                  stats = &m_groups[key];
+                  grouped = true;
+               }
+            }
+
+            if (values.isNull(i))
+            {
+               stats->addNull();
+            }
+            else
+            {
+               switch (values.type())
+               {
+               case ColumnBatch::Int64:
+                  stats->addValue(double(values.int64Values().at(i)));
+                  break;
+               case ColumnBatch::Double:
+                  stats->addValue(values.doubleValues().at(i));
+                  break;
+               default:
+                  stats->addValue(values.value(i).toDouble());
+                  break;
+               }
+            }
+         }
+      }
+
+      /*!
+      \brief Returns aggregates of the non-NULL keys
+      */
+      const QHash<Key, Stats> &groups() const
+      {
+         return m_groups;
+      }
+
+      /*!
+      \brief Returns aggregate of the rows with SQL NULL key
+      */
+      const Stats &nullGroup() const
+      {
+         return m_nullGroup;
+      }
+
+      /*!
+      \brief Returns aggregate of the rows whose key does not convert to the key type without loss
+      */
+      const Stats &invalidKeyGroup() const
+      {
+         return m_invalidKeyGroup;
+      }
+
+   private:
+      static bool keyAt(const ColumnBatch::Column &column, int row, qint64 &key)
+      {
+         switch (column.type())
+         {
+         case ColumnBatch::Int64:
+            key = column.int64Values().at(row);
+            return true;
+         case ColumnBatch::Double:
+            return toInt64(column.doubleValues().at(row), key);
+         default:
+         {
+            const QVariant value = column.value(row);
+
+            switch (ColumnBatch::columnType(value.type()))
+            {
+            case ColumnBatch::Int64:
+               key = value.toLongLong();
+               return true;
+            case ColumnBatch::Double:
+               return toInt64(value.toDouble(), key);
+            default:
+               return false;
+            }
+         }
+         }
+      }
+
+      static bool keyAt(const ColumnBatch::Column &column, int row, double &key)
+      {
+         switch (column.type())
+         {
+         case ColumnBatch::Int64:
+            key = double(column.int64Values().at(row));
+            return true;
+         case ColumnBatch::Double:
+            key = column.doubleValues().at(row);
+            return true;
+         default:
+         {
+            const QVariant value = column.value(row);
+
+            const ColumnBatch::ColumnType type = ColumnBatch::columnType(value.type());
+
+            key = value.toDouble();
+
+            return type == ColumnBatch::Int64 || type == ColumnBatch::Double;
+         }
+         }
+      }
+
+      static bool keyAt(const ColumnBatch::Column &column, int row, QString &key)
+      {
+         if (column.type() == ColumnBatch::String)
+            key = column.string(row);
+         else
+            key = column.value(row).toString();
+
+         return true;
+      }
+
+      template<typename T>
+      static bool keyAt(const ColumnBatch::Column &column, int row, T &key)
+      {
+         key = ValueConverter<T>::convert(column.value(row));
+
+         return true;
+      }
+
+      QHash<Key, Stats> m_groups;
+      Stats m_nullGroup;
+      Stats m_invalidKeyGroup;
+   };
+
+private:
+   //true if value is a whole number in the qint64 range
+   static bool toInt64(double value, qint64 &result)
+   {
+      if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0))
+         return false;
+
+      result = qint64(value);
+
+      return double(result) == value;
+   }
+};
+
+#endif // EASYQTSQL_AGGREGATE_H
@@ -0,0 +1,438 @@
+#ifndef EASYQTSQL_COLUMNBATCH_H
+#define EASYQTSQL_COLUMNBATCH_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+
+#endif
+
+/*!
+\brief Batch of result rows stored column by column (struct of arrays).
+
+Each column keeps its values in one contiguous typed buffer:
+- ColumnBatch::Int64 columns (SQL integer and boolean types) in QVector<qint64>;
+- ColumnBatch::Double columns (SQL floating point types) in QVector<double>;
+- ColumnBatch::String columns in one character buffer with row offsets (the string of row i is chars[offsets[i] .. offsets[i + 1]));
+- other columns (dates, blobs, columns of unknown type) in QVector<QVariant>.
+
+SQL NULL values are marked in the null bitmap of the column (bit i of the bitmap is set if the value of row i is NULL),
+the typed buffer holds 0 (empty string) for them.
+
+The buffer type comes from the field type of the result record (QSqlRecord). Databases with dynamic typing (SQLite) may return
+a value of another type, e.g. a text or REAL value in an INTEGER column: the column is switched to ColumnBatch::Variant
+for the rest of the batch then, so no value is lost. Integer values are accepted in ColumnBatch::Double columns. Check Column::type() of every batch.
+
+\code
+QueryResult res = t.execQuery("SELECT id, price, name FROM goods");
+
+ColumnBatch batch;
+
+while (res.fetchColumns(batch, 10000) > 0)
+{
+   const QVector<double> &prices = batch.column(1).doubleValues();
+
+   double sum = 0;
+
+   for (int i = 0; i < batch.rowCount(); ++i)
+   {
+      sum += prices[i];
+   }
+}
+\endcode
+
+\sa QueryResult::fetchColumns
+*/
+class ColumnBatch
+{
+   friend class QueryResult;
+
+public:
+   enum ColumnType
+   {
+      Int64,
+      Double,
+      String,
+      Variant
+   };
+
+   /*!
+   \brief Typed buffer of a single result column
+   */
+   class Column
+   {
+      friend class ColumnBatch;
+
+   public:
+      Column()
+       : m_type(Variant)
+       , m_count(0)
+       , m_nullCount(0)
+      { }
+
+      /*!
+      \brief Returns the result column name
+      */
+      QString name() const
+      {
+         return m_name;
+      }
+
+      /*!
+      \brief Returns type of the column buffer
+      */
+      ColumnType type() const
+      {
+         return m_type;
+      }
+
+      /*!
+      \brief Returns count of values (rows) in the column
+      */
+      int count() const
+      {
+         return m_count;
+      }
+
+      /*!
+      \brief Returns count of SQL NULL values in the column
+      */
+      int nullCount() const
+      {
+         return m_nullCount;
+      }
+
+      /*!
+      \brief Returns true if the value of row is SQL NULL
+      */
+      bool isNull(int row) const
+      {
+         return (m_nulls.at(row >> 6) >> (row & 63)) & 1;
+      }
+
+      /*!
+      \brief Returns null bitmap: bit (row % 64) of word (row / 64) is set if the value of row is SQL NULL
+      */
+      const QVector<quint64> &nullBitmap() const
+      {
+         return m_nulls;
+      }
+
+      /*!
+      \brief Returns values of ColumnBatch::Int64 column
+      */
+      const QVector<qint64> &int64Values() const
+      {
+         return m_int64Values;
+      }
+
+      /*!
+      \brief Returns values of ColumnBatch::Double column
+      */
+      const QVector<double> &doubleValues() const
+      {
+         return m_doubleValues;
+      }
+
+      /*!
+      \brief Returns count() + 1 offsets of ColumnBatch::String column values in the character buffer
+      \sa ColumnBatch::Column::stringChars
+      */
+      const QVector<int> &stringOffsets() const
+      {
+         return m_stringOffsets;
+      }
+
+      /*!
+      \brief Returns character buffer of ColumnBatch::String column values
+      \sa ColumnBatch::Column::stringOffsets
+      */
+      const QString &stringChars() const
+      {
+         return m_stringChars;
+      }
+
+      /*!
+      \brief Returns string of row of ColumnBatch::String column
+      */
+      QString string(int row) const
+      {
+         const int offset = m_stringOffsets.at(row);
+
+         return m_stringChars.mid(offset, m_stringOffsets.at(row + 1) - offset);
+      }
+
+      /*!
+      \brief Returns values of ColumnBatch::Variant column
+      */
+      const QVector<QVariant> &variantValues() const
+      {
+         return m_variantValues;
+      }
+
+      /*!
+      \brief Returns value of row converted to QVariant (any column type). SQL NULL value is returned as null QVariant.
+      */
+      QVariant value(int row) const
+      {
+         if (isNull(row))
+            return QVariant();
+
+         switch (m_type)
+         {
+         case Int64:
+            return m_int64Values.at(row);
+         case Double:
+            return m_doubleValues.at(row);
+         case String:
+            return string(row);
+         default:
+            return m_variantValues.at(row);
+         }
+      }
+
+   private:
+      void reset(const QString &name, ColumnType type, int capacity)
+      {
+         m_name = name;
+         m_type = type;
+         m_count = 0;
+         m_nullCount = 0;
+
+         //QVector::clear() and QString::resize(0) keep the capacity, so the buffers are reused by the next batch
+         m_nulls.clear();
+         m_int64Values.clear();
+         m_doubleValues.clear();
+         m_stringOffsets.clear();
+         m_stringChars.resize(0); //QString::clear() frees the buffer
+         m_variantValues.clear();
+
+         m_nulls.reserve((capacity + 63) / 64);
+
+         switch (m_type)
+         {
+         case Int64:
+            m_int64Values.reserve(capacity);
+            break;
+         case Double:
+            m_doubleValues.reserve(capacity);
+            break;
+         case String:
+            m_stringOffsets.reserve(capacity + 1);
+            m_stringOffsets.append(0);
+            break;
+         default:
+            m_variantValues.reserve(capacity);
+            break;
+         }
+      }
+
+      void append(const QVariant &value)
+      {
+         if ((m_count & 63) == 0)
+            m_nulls.append(0);
+
+         const bool isNull = value.isNull();
+
+         if (isNull)
+         {
+            m_nulls.last() |= quint64(1) << (m_count & 63);
+            ++m_nullCount;
+         }
+
+         //the value type decides, conversions of other types may round (REAL to INTEGER) or change the value type (text to number)
+         const ColumnType valueType = isNull ? m_type : columnType(value.type());
+
+         switch (m_type)
+         {
+         case Int64:
+            if (valueType == Int64)
+            {
+               m_int64Values.append(isNull ? 0 : value.toLongLong());
+               break;
+            }
+
+            toVariant();
+            m_variantValues.append(value);
+            break;
+         case Double:
+            if (valueType == Double || valueType == Int64)
+            {
+               m_doubleValues.append(isNull ? 0.0 : value.toDouble());
+               break;
+            }
+
+            toVariant();
+            m_variantValues.append(value);
+            break;
+         case String:
+            if (!isNull)
+               m_stringChars.append(value.toString());
+            m_stringOffsets.append(m_stringChars.size());
+            break;
+         default:
+            m_variantValues.append(value);
+            break;
+         }
+
+         ++m_count;
+      }
+
+      /*!
+      \brief Moves the values to the variant buffer, used when a value does not convert to the column type (SQLite dynamic typing)
+      */
+      void toVariant()
+      {
+         m_variantValues.reserve(qMax(m_int64Values.capacity(), m_doubleValues.capacity()));
+
+         for (int row = 0; row < m_count; ++row)
+         {
+            m_variantValues.append(value(row));
+         }
+
+         m_type = Variant;
+
+         m_int64Values.clear();
+         m_doubleValues.clear();
+      }
+
+      QString m_name;
+      ColumnType m_type;
+      int m_count;
+      int m_nullCount;
+
+      QVector<quint64> m_nulls;
+      QVector<qint64>  m_int64Values;
+      QVector<double>  m_doubleValues;
+      QVector<int>     m_stringOffsets;
+      QString          m_stringChars;
+      QVector<QVariant> m_variantValues;
+   };
+
+   ColumnBatch()
+    : m_rowCount(0)
+   { }
+
+   /*!
+   \brief Returns count of rows in the batch
+   */
+   int rowCount() const
+   {
+      return m_rowCount;
+   }
+
+   /*!
+   \brief Returns true if the batch has no rows
+   */
+   bool isEmpty() const
+   {
+      return m_rowCount == 0;
+   }
+
+   /*!
+   \brief Returns count of columns in the batch
+   */
+   int columnCount() const
+   {
+      return m_columns.count();
+   }
+
+   /*!
+   \brief Returns column at index
+   */
+   const Column &column(int index) const
+   {
+      return m_columns.at(index);
+   }
+
+   /*!
+   \brief Returns index of the column called name (case insensitive) or -1 if there is no such column
+   */
+   int indexOf(const QString &name) const
+   {
+      for (int i = 0; i < m_columns.count(); ++i)
+      {
+         if (m_columns.at(i).name().compare(name, Qt::CaseInsensitive) == 0)
+            return i;
+      }
+
+      return -1;
+   }
+
+   /*!
+   \brief Returns buffer type used for SQL field type
+   */
+   static ColumnType columnType(QVariant::Type fieldType)
+   {
+      switch (fieldType)
+      {
+      case QVariant::Bool:
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+         return Int64;
+      case QVariant::Double:
+         return Double;
+      case QVariant::String:
+         return String;
+      default:
+         return Variant;
+      }
+   }
+
+private:
+   void reset(const QSqlRecord &record, int capacity)
+   {
+      m_rowCount = 0;
+
+      m_columns.resize(record.count());
+
+      for (int i = 0; i < record.count(); ++i)
+      {
+         const QSqlField field = record.field(i);
+
+         m_columns[i].reset(field.name(), columnType(field.type()), capacity);
+      }
+   }
+
+   void appendRow(const QSqlQuery &query)
+   {
+      for (int i = 0; i < m_columns.count(); ++i)
+      {
+         m_columns[i].append(query.value(i));
+      }
+
+      ++m_rowCount;
+   }
+
+   QVector<Column> m_columns;
+   int m_rowCount;
+};
+
+#endif // EASYQTSQL_COLUMNBATCH_H
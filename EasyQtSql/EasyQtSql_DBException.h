@@ -43,6 +43,10 @@ class DBException : public QException
    friend class InsertQuery;
    friend class UpdateQuery;
    friend class DeleteQuery;
+   friend class UpsertQuery;
+   friend class SqlFactory;
+   friend class PrefetchResult;
+   friend class KeysetPaginator;
 
 public:
    const QSqlError lastError;
@@ -57,6 +61,10 @@ private:
    explicit DBException (const QSqlDatabase &db)
     : lastError(db.lastError())
    { }
+
+   explicit DBException (const QSqlError &error)
+    : lastError(error)
+   { }
 };
 
 #endif // EASYQTSQL_DBEXCEPTION_H
@@ -30,6 +30,7 @@
 
 #include <QtSql>
 #include "EasyQtSql_NonQueryResult.h"
+#include "EasyQtSql_SqlFactory.h"
 
 #endif
 
@@ -41,6 +42,7 @@ class  DeleteQuery
 public:
    DeleteQuery(const QString &table, const QSqlDatabase &db)
      : m_query(db)
+     , m_db(db)
      , m_table(table)
    {   }
 
@@ -54,25 +56,14 @@ public:
    */
    NonQueryResult where(const QString &expr)
    {
-      const QString &sql = createSql(m_table, expr);
-
-      const bool res = m_query.exec(sql);
-
-#ifdef DB_EXCEPTIONS_ENABLED
-
-      if (!res)
-         throw DBException(m_query);
-
-#endif
-
-      return NonQueryResult(m_query);
+      return execSql(createSql(m_table, expr));
    }
 
    /*!
    \brief Executes conditional <em>DELETE FROM table WHERE expr</em> query with parameter binding
 
    The method supports variable count of QVariant parameters.
-   Parameters are bound with <em>QSqlQuery::addBindValue</em>.
+   Parameters are bound positionally with <em>QSqlQuery::bindValue</em>.
    \code
    //DELETE FROM table WHERE a=1 AND b=2
    t.deleteFrom("table").where("a=? AND b=?", 1, 2);
@@ -84,13 +75,17 @@ public:
 
       const QString &sql = createSql(m_table, expr);
 
-      m_query.prepare(sql);
+      m_statement = SqlFactory::prepareStatement(m_db, sql, m_query);
 
       for (int i = 0; i < m_params.count(); ++i)
       {
-         m_query.addBindValue(m_params.at(i));
+         m_query.bindValue(i, m_params.at(i));
       }
 
+      SqlFactory::WriteLock writeLock(m_db);
+
+      SqlFactory::markWrite();
+
       const bool res = m_query.exec();
 
 #ifdef DB_EXCEPTIONS_ENABLED
@@ -100,7 +95,7 @@ public:
 
 #endif
 
-      return NonQueryResult(m_query);
+      return NonQueryResult(m_query, m_statement);
    }
 
    template <typename... Rest> NonQueryResult where(const QString &expr, const QVariant &first, const Rest&... rest)
@@ -119,31 +114,42 @@ public:
    */
    NonQueryResult exec()
    {
-      const QString &sql = createSql(m_table);
-
-      const bool res = m_query.exec(sql);
-
-#ifdef DB_EXCEPTIONS_ENABLED
-
-      if (!res)
-         throw DBException(m_query);
-
-#endif
-
-      return NonQueryResult(m_query);
+      return execSql(QString("DELETE FROM %0").arg(m_table));
    }
 
 
 private:
    QSqlQuery m_query;
+   QSqlDatabase m_db;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
    QString m_table;
    QVariantList m_params;
 
-   static QString createSql(const QString &table, const QString &expr = "1=1")
+   static QString createSql(const QString &table, const QString &expr)
    {
       return QString("DELETE FROM %0 WHERE %1").arg(table).arg(expr);
    }
 
+   NonQueryResult execSql(const QString &sql)
+   {
+      m_statement = SqlFactory::prepareStatement(m_db, sql, m_query);
+
+      SqlFactory::WriteLock writeLock(m_db);
+
+      SqlFactory::markWrite();
+
+      const bool res = m_query.exec();
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+      if (!res)
+         throw DBException(m_query);
+
+#endif
+
+      return NonQueryResult(m_query, m_statement);
+   }
+
 };
 
 #endif // EASYQTSQL_DELETEQUERY_H
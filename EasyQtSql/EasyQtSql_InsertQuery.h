@@ -30,6 +30,8 @@
 
 #include <QtSql>
 #include "EasyQtSql_NonQueryResult.h"
+#include "EasyQtSql_SqlFactory.h"
+#include "EasyQtSql_SqlDialect.h"
 
 #endif
 
@@ -39,16 +41,29 @@
 class  InsertQuery
 {
 public:
+   /*!
+   \brief Execution modes of several queued values rows
+   */
+   enum BatchMode
+   {
+      ExecBatch,      //!< Single-row statement executed with QSqlQuery::execBatch. Drivers without batch support (QSQLITE, QMYSQL, QPSQL, ...) execute it row by row.
+      MultiRowValues  //!< <em>INSERT INTO table VALUES (?,?),(?,?),...</em> statements with as many rows as the driver bound parameters limit allows
+   };
+
    InsertQuery(const QString &table, const QSqlDatabase &db)
      : m_table(table)
      , q(db)
+     , m_db(db)
+   {   }
+
+   virtual ~InsertQuery()
    {   }
 
    /*!
    \brief Adds list of insert-values to INSERT INTO table(...) VALUES ... query
 
    The method supports variable count of QVariant parameters.
-   Parameters are bound with <em>QSqlQuery::addBindValue</em>.
+   Parameters are bound positionally with <em>QSqlQuery::bindValue</em>.
    \code
    NonQueryResult res = t.insertInto("table (a, b, c, d)")
          .values(1, 2, 3, "a")
@@ -87,25 +102,227 @@ public:
       return values(rest...);
    }
 
+   /*!
+   \brief Sets execution mode of several queued values rows
+
+   In MultiRowValues mode the rows are split into chunks of SqlDialect::maxValuesRows() rows (limited by maxChunkRows if positive).
+   The full chunk and the remainder chunk statements are prepared once and re-executed by the following InsertQuery::exec calls.
+   Dialects without multi-row VALUES support fall back to ExecBatch.
+   \code
+   InsertQuery query = t.insertInto("table (a, b)").setBatchMode(InsertQuery::MultiRowValues);
+
+   for (int i = 0; i < 10000; ++i)
+   {
+      query.values(i, i * 2);
+   }
+
+   //INSERT INTO table (a, b) VALUES (?,?),(?,?),... executed 21 times (499 rows per chunk for SQLite)
+   query.exec();
+   \endcode
+   \note NonQueryResult::numRowsAffected() returns the row count of the last executed chunk.
+   */
+   InsertQuery &setBatchMode(BatchMode mode, int maxChunkRows = 0)
+   {
+      m_batchMode = mode;
+      m_maxChunkRows = maxChunkRows;
+
+      return *this;
+   }
+
+   /*!
+   \brief Returns execution mode of several queued values rows
+   */
+   BatchMode batchMode() const
+   {
+      return m_batchMode;
+   }
+
+   /*!
+   \brief Inserts Q_GADGET items of container (QVector, QList, std::vector, ...) with a single InsertQuery::exec call
+
+   If the table has no column list, the readable stored properties of the gadget are inserted and their names are appended to the table as the column list.
+   Otherwise the properties with the same (case sensitive) names as the listed columns are inserted.
+   The property-to-column plan is computed once per gadget type, the column arrays are filled directly from the properties.
+   Rows queued with InsertQuery::values are inserted before the gadgets, they must have as many values as the plan has columns.
+   \code
+   QVector<Row> rows = ...;
+
+   //INSERT INTO table (a, b, c, d) VALUES (?,?,?,?)
+   t.insertInto("table").fromGadgets(rows);
+
+   //INSERT INTO table (a, d) VALUES (?,?)
+   t.insertInto("table (a, d)").setBatchMode(InsertQuery::MultiRowValues).fromGadgets(rows);
+   \endcode
+   If a listed column has no gadget property or the queued rows have another column count, nothing is inserted and the error is reported with DBException (NonQueryResult::lastError if exceptions are disabled).
+   \throws DBException
+   */
+   template<typename Container>
+   NonQueryResult fromGadgets(const Container &gadgets)
+   {
+      typedef typename Container::value_type T;
+
+      const InsertPlan &plan = insertPlan(&T::staticMetaObject);
+
+      for (int col = 0; col < plan.count(); ++col)
+      {
+         if (!plan.at(col).isValid())
+            return rejected(QString("Property %0 is not found in %1").arg(tableColumns().value(col)).arg(QLatin1String(T::staticMetaObject.className())));
+      }
+
+      if (!prepareColumns(plan.count()))
+         return rejected(QString("%0 queued values do not match %1 gadget columns").arg(m_insertArray.count()).arg(plan.count()));
+
+      for (int col = 0; col < plan.count(); ++col)
+      {
+         const QMetaProperty &property = plan.at(col);
+
+         QVariantList &values = m_insertArray[col];
+         values.reserve(values.count() + int(gadgets.size()));
+
+         for (const T &gadget : gadgets)
+         {
+            values.append(property.readOnGadget(&gadget));
+         }
+      }
+
+      return execColumns();
+   }
+
+   /*!
+   \brief Inserts plain structs of container (QVector, QList, std::vector, ...) projected on members with a single InsertQuery::exec call
+
+   The members are bound in order of the table column list, the column arrays are filled directly from the members.
+   Rows queued with InsertQuery::values are inserted before the structs, they must have as many values as there are members.
+   \code
+   struct Point { int x; int y; QString name; };
+
+   QVector<Point> points = ...;
+
+   //INSERT INTO table (x, name) VALUES (?,?)
+   t.insertInto("table (x, name)").fromStructs(points, &Point::x, &Point::name);
+   \endcode
+   \throws DBException
+   */
+   template<typename Container, typename T, typename... Ms>
+   NonQueryResult fromStructs(const Container &rows, Ms T::*... members)
+   {
+      if (!prepareColumns(int(sizeof...(Ms))))
+         return rejected(QString("%0 queued values do not match %1 struct members").arg(m_insertArray.count()).arg(int(sizeof...(Ms))));
+
+      appendMemberColumns(rows, 0, members...);
+
+      return execColumns();
+   }
+
+   /*!
+   \brief Requests keys of the inserted rows, see NonQueryResult::insertedIds
+
+   The keys are retrieved depending on the dialect:
+   - the inserted values are the keys if idColumn is in the table column list;
+   - PostgreSQL: multi-row <em>INSERT ... RETURNING idColumn</em> statements;
+   - SQLite: multi-row statements, the keys of a statement are inferred from the last inserted rowid and the row count.
+     idColumn must be the INTEGER PRIMARY KEY (rowid alias) column of the table;
+   - other dialects: rows are inserted one by one, the keys are taken from QSqlQuery::lastInsertId().
+
+   Batch mode (see InsertQuery::setBatchMode) does not apply, the maxChunkRows limit does.
+   \code
+   NonQueryResult res = t.insertInto("parent (name)")
+         .returningIds("id")
+         .values("a")
+         .values("b")
+         .exec();
+
+   const QVector<QVariant> ids = res.insertedIds(); //ids of the "a" and "b" rows
+   \endcode
+   \param idColumn Generated key column
+   */
+   InsertQuery &returningIds(const QString &idColumn)
+   {
+      m_idColumn = idColumn.trimmed();
+
+      return *this;
+   }
+
    /*!
    \brief Executes prepared InsertQuery with insert values list
    */
    NonQueryResult exec()
    {
-      QString sql = QLatin1String("INSERT INTO ");
-      sql.append(m_table);
-      sql.append(QLatin1String(" VALUES ("));
+      const int columnCount = m_insertArray.count();
+      const int rowCount = columnCount > 0 ? m_insertArray.first().count() : 0;
+
+      if (!m_idColumn.isEmpty() && rowCount > 0)
+         return execReturningIds(columnCount, rowCount);
+
+      return execRows(columnCount, rowCount);
+   }
+
+protected:
+   QString m_table;
+
+   //INSERT INTO table VALUES (?,?),(?,?) with rowCount rows
+   virtual QString createSql(int rowCount) const
+   {
+      return QString("INSERT INTO %1 VALUES %2").arg(m_table, placeholderRows(m_insertArray.count(), rowCount));
+   }
+
+   //false if createSql does not insert every row (e.g. upserts), so the keys can not be inferred
+   virtual bool isPlainInsert() const
+   {
+      return true;
+   }
+
+   //(?,?),(?,?) with rowCount rows of columnCount placeholders
+   static QString placeholderRows(int columnCount, int rowCount)
+   {
+      QString row = QLatin1String("(");
+
+      for (int i = 0; i < columnCount; ++i)
+      {
+         row.append(i == 0 ? QLatin1String("?") : QLatin1String(",?"));
+      }
+
+      row.append(QLatin1String(")"));
+
+      QString rows;
+      rows.reserve(rowCount * (row.length() + 1));
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         if (i > 0)
+            rows.append(QLatin1Char(','));
+
+         rows.append(row);
+      }
+
+      return rows;
+   }
+
+private:
+   NonQueryResult execRows(int columnCount, int rowCount)
+   {
+      if (m_batchMode == MultiRowValues && rowCount > 1)
+      {
+         int chunkRows = SqlDialect(m_db).maxValuesRows(columnCount);
+
+         if (m_maxChunkRows > 0)
+            chunkRows = qMin(chunkRows, m_maxChunkRows);
+
+         if (chunkRows > 1)
+            return execChunks(qMin(chunkRows, rowCount));
+      }
+
+      const QString &sql = createSql(1);
 
-      QStringList lst;
-      for (int i = 0; i < m_insertArray.count(); ++i)
+      if (sql != m_preparedSql) //the same statement is re-executed without preparation
       {
-         lst.append(QLatin1String("?"));
+         m_statement = SqlFactory::prepareStatement(m_db, sql, q);
+         m_preparedSql = sql;
       }
 
-      sql.append(lst.join(QLatin1String(",")));
-      sql.append(QLatin1String(")"));
+      SqlFactory::WriteLock writeLock(m_db);
 
-      q.prepare(sql);
+      SqlFactory::markWrite();
 
       bool res = false;
 
@@ -113,7 +330,7 @@ public:
       {
          for (int i = 0; i < m_insertArray.count(); ++i)
          {
-            q.addBindValue(m_insertArray.at(i));
+            q.bindValue(i, m_insertArray.at(i));
          }
 
          res = q.execBatch();
@@ -122,7 +339,7 @@ public:
       {
          for (int i = 0; i < m_insertArray.count(); ++i)
          {
-            q.addBindValue(m_insertArray.at(i).first());
+            q.bindValue(i, m_insertArray.at(i).first());
          }
 
          res = q.exec();
@@ -138,14 +355,318 @@ public:
 
 #endif
 
-      return NonQueryResult(q);
+      return NonQueryResult(q, m_statement);
    }
 
-private:
-   QString m_table;
+   struct Chunk
+   {
+      QSqlQuery query;
+      QSharedPointer<QSqlQuery> statement; //cached statement lease (see StatementCache)
+      QString sql;
+   };
+
    QSqlQuery q;
+   QSqlDatabase m_db;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
+   QString m_preparedSql;
    QVariantList m_args;
    QVector<QVariantList> m_insertArray;
+
+   BatchMode m_batchMode = ExecBatch;
+   int m_maxChunkRows = 0;
+   QString m_idColumn;
+   Chunk m_fullChunk;
+   Chunk m_tailChunk;
+
+   typedef QVector<QMetaProperty> InsertPlan;
+
+   QHash<const QMetaObject*, InsertPlan> m_insertPlans;
+
+   /*!
+   \brief Returns readable properties of metaobject in order of the table columns.
+   The plan is computed on the first call for the metaobject, the column list is appended to the table if it has none.
+   */
+   const InsertPlan &insertPlan(const QMetaObject *metaobject)
+   {
+      auto it = m_insertPlans.find(metaobject);
+
+      if (it != m_insertPlans.end())
+         return it.value();
+
+      InsertPlan plan;
+
+      const int open = m_table.indexOf(QLatin1Char('('));
+
+      if (open < 0)
+      {
+         QStringList columns;
+
+         for (int i = 0; i < metaobject->propertyCount(); ++i)
+         {
+            const QMetaProperty metaproperty = metaobject->property(i);
+
+            if (metaproperty.isReadable() && metaproperty.isStored())
+            {
+               plan.append(metaproperty);
+               columns.append(QLatin1String(metaproperty.name()));
+            }
+         }
+
+         m_table = QString("%0 (%1)").arg(m_table.trimmed()).arg(columns.join(QLatin1String(", ")));
+      }
+      else
+      {
+         const int close = m_table.indexOf(QLatin1Char(')'), open);
+
+         const QStringList columns = m_table.mid(open + 1, close - open - 1).split(QLatin1Char(','));
+
+         for (const QString &column : columns)
+         {
+            const int index = metaobject->indexOfProperty(column.trimmed().toLatin1().constData());
+
+            plan.append(metaobject->property(index)); //invalid property if not found, rejected by fromGadgets
+         }
+      }
+
+      return m_insertPlans.insert(metaobject, plan).value();
+   }
+
+   template<typename Container>
+   void appendMemberColumns(const Container &, int)
+   { }
+
+   template<typename Container, typename T, typename M, typename... Ms>
+   void appendMemberColumns(const Container &rows, int column, M T::*member, Ms T::*... rest)
+   {
+      QVariantList &values = m_insertArray[column];
+      values.reserve(values.count() + int(rows.size()));
+
+      for (const T &row : rows)
+      {
+         values.append(QVariant::fromValue(row.*member));
+      }
+
+      appendMemberColumns(rows, column + 1, rest...);
+   }
+
+   //false if the rows queued with values() have another column count
+   bool prepareColumns(int columnCount)
+   {
+      if (m_insertArray.isEmpty())
+         m_insertArray = QVector<QVariantList>(columnCount);
+
+      return m_insertArray.count() == columnCount;
+   }
+
+   //fails with DBException, or reports error through NonQueryResult::lastError if exceptions are disabled
+   NonQueryResult rejected(const QString &text)
+   {
+      const QSqlError error(QString(), text, QSqlError::StatementError);
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+      throw DBException(error);
+
+#else
+
+      NonQueryResult res(q, m_statement);
+      res.m_error = error;
+
+      return res;
+
+#endif
+   }
+
+   //executes column arrays filled by fromGadgets/fromStructs
+   NonQueryResult execColumns()
+   {
+      if (m_insertArray.isEmpty() || m_insertArray.first().isEmpty())
+      {
+         m_insertArray.clear();
+
+         return NonQueryResult(q, m_statement); //nothing to insert
+      }
+
+      return exec();
+   }
+
+   enum IdRetrieval
+   {
+      NoIds,
+      ReturningIds,     //keys are read from the RETURNING result
+      LastInsertIdRange //keys are lastInsertId() - rows + 1 ... lastInsertId()
+   };
+
+   //columns of the table column list
+   QStringList tableColumns() const
+   {
+      QStringList columns;
+
+      const int open = m_table.indexOf(QLatin1Char('('));
+      const int close = m_table.lastIndexOf(QLatin1Char(')'));
+
+      if (open >= 0 && close > open)
+      {
+         for (const QString &column : m_table.mid(open + 1, close - open - 1).split(QLatin1Char(',')))
+         {
+            columns.append(column.trimmed());
+         }
+      }
+
+      return columns;
+   }
+
+   NonQueryResult execReturningIds(int columnCount, int rowCount)
+   {
+      const QStringList columns = tableColumns();
+
+      int idIndex = -1;
+
+      for (int i = 0; i < columns.count() && idIndex < 0; ++i)
+      {
+         if (columns.at(i).compare(m_idColumn, Qt::CaseInsensitive) == 0)
+            idIndex = i;
+      }
+
+      if (idIndex >= 0 || !isPlainInsert())
+      {
+         //the keys are inserted explicitly (or can not be inferred)
+         const QVector<QVariant> ids = idIndex >= 0 ? m_insertArray.at(idIndex).toVector() : QVector<QVariant>();
+
+         NonQueryResult res = execRows(columnCount, rowCount);
+         res.m_insertedIds = ids;
+
+         return res;
+      }
+
+      const SqlDialect dialect(m_db);
+
+      IdRetrieval retrieval = LastInsertIdRange;
+      int chunkRows = 1;
+
+      if (dialect.type() == SqlDialect::PostgreSql)
+      {
+         retrieval = ReturningIds;
+         chunkRows = dialect.maxValuesRows(columnCount);
+      }
+      else if (dialect.type() == SqlDialect::SQLite)
+      {
+         chunkRows = dialect.maxValuesRows(columnCount);
+      }
+
+      if (m_maxChunkRows > 0)
+         chunkRows = qMin(chunkRows, m_maxChunkRows);
+
+      return execChunks(qMin(chunkRows, rowCount), retrieval);
+   }
+
+   static void collectIds(QSqlQuery &query, int rows, IdRetrieval retrieval, QVector<QVariant> &ids)
+   {
+      if (retrieval == ReturningIds)
+      {
+         while (query.next())
+         {
+            ids.append(query.value(0));
+         }
+      }
+      else if (retrieval == LastInsertIdRange)
+      {
+         const QVariant lastId = query.lastInsertId();
+
+         if (rows == 1)
+         {
+            ids.append(lastId);
+            return;
+         }
+
+         bool ok = false;
+         const qint64 last = lastId.toLongLong(&ok);
+
+         //rowids of a single INSERT statement are consecutive
+         const bool inferred = ok && query.numRowsAffected() == rows;
+
+         for (int i = 0; i < rows; ++i)
+         {
+            ids.append(inferred ? QVariant(last - rows + 1 + i) : QVariant());
+         }
+      }
+   }
+
+   void prepareChunk(Chunk &chunk, int rowCount, const QString &suffix)
+   {
+      const QString &sql = createSql(rowCount) + suffix;
+
+      if (sql != chunk.sql)
+      {
+         chunk.statement = SqlFactory::prepareStatement(m_db, sql, chunk.query);
+         chunk.sql = sql;
+      }
+   }
+
+   //executes queued rows with multi-row VALUES statements of chunkRows rows and a remainder statement
+   NonQueryResult execChunks(int chunkRows, IdRetrieval retrieval = NoIds)
+   {
+      const int columnCount = m_insertArray.count();
+      const int rowCount = m_insertArray.first().count();
+      const int tailRows = rowCount % chunkRows;
+
+      const QString suffix = retrieval == ReturningIds ? QString(" RETURNING %1").arg(m_idColumn) : QString();
+
+      prepareChunk(m_fullChunk, chunkRows, suffix);
+
+      if (tailRows > 0)
+         prepareChunk(m_tailChunk, tailRows, suffix);
+
+      QVector<QVariant> ids;
+
+      if (retrieval != NoIds)
+         ids.reserve(rowCount);
+
+      SqlFactory::WriteLock writeLock(m_db);
+
+      SqlFactory::markWrite();
+
+      Chunk *chunk = &m_fullChunk;
+
+      bool res = true;
+
+      for (int start = 0; start < rowCount && res; start += chunkRows)
+      {
+         const int rows = qMin(chunkRows, rowCount - start);
+
+         chunk = rows == chunkRows ? &m_fullChunk : &m_tailChunk;
+
+         int index = 0;
+
+         for (int row = start; row < start + rows; ++row)
+         {
+            for (int col = 0; col < columnCount; ++col)
+            {
+               chunk->query.bindValue(index++, m_insertArray.at(col).at(row));
+            }
+         }
+
+         res = chunk->query.exec();
+
+         if (res)
+            collectIds(chunk->query, rows, retrieval, ids);
+      }
+
+      m_args.clear();
+      m_insertArray.clear();
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+      if (!res)
+         throw DBException(chunk->query);
+
+#endif
+
+      NonQueryResult result(chunk->query, chunk->statement);
+      result.m_insertedIds = ids;
+
+      return result;
+   }
 };
 
 #endif // EASYQTSQL_INSERTQUERY_H
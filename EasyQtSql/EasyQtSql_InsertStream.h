@@ -0,0 +1,256 @@
+#ifndef EASYQTSQL_INSERTSTREAM_H
+#define EASYQTSQL_INSERTSTREAM_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include <functional>
+#include "EasyQtSql_InsertQuery.h"
+
+#endif
+
+/*!
+\brief Streaming <em>INSERT INTO table</em> with bounded memory.
+
+Rows are queued to the wrapped InsertQuery and flushed automatically every <em>flushRows</em> rows or <em>flushBytes</em> bytes of queued values,
+so memory does not grow with the input size. The flushes run on the connection of the stream, i.e. inside the current Transaction.
+The prepared statements of the InsertQuery are reused by all flushes.
+
+Call InsertStream::flush after the last row: the destructor does not flush the remaining rows, because it could not report errors.
+
+\code
+Transaction t;
+
+InsertStream stream = t.insertStream("table (a, b)", 50000);
+
+stream.setBatchMode(InsertQuery::MultiRowValues)
+      .onFlush([](const InsertStream::FlushInfo &info)
+      {
+         qDebug() << info.totalRows << "rows inserted, last flush" << info.rows << "rows in" << info.elapsed << "us";
+      });
+
+for (int i = 0; i < 50000000; ++i)
+{
+   stream.values(i, i * 2);
+}
+
+stream.flush();
+
+t.commit();
+\endcode
+\sa Database::insertStream
+*/
+class InsertStream
+{
+public:
+   /*!
+   \brief Statistics of a single flush passed to the InsertStream::onFlush callback
+   */
+   struct FlushInfo
+   {
+      int rows = 0;          //!< rows written by the flush
+      qint64 bytes = 0;      //!< estimated size of the flushed values
+      qint64 elapsed = 0;    //!< flush time, us
+      qint64 totalRows = 0;  //!< rows written by all flushes of the stream
+      int flushCount = 0;    //!< count of flushes including this one
+   };
+
+   /*!
+   \param table Table to insert into with list of columns
+   \param db Connection
+   \param flushRows Max count of queued rows
+   \param flushBytes Max estimated size of queued values, zero disables the limit
+   */
+   InsertStream(const QString &table, const QSqlDatabase &db, int flushRows = 10000, qint64 flushBytes = 16 * 1024 * 1024)
+      : m_query(table, db)
+      , m_flushRows(qMax(1, flushRows))
+      , m_flushBytes(qMax(qint64(0), flushBytes))
+   { }
+
+   /*!
+   \brief Sets execution mode of the flushed rows
+   \sa InsertQuery::setBatchMode
+   */
+   InsertStream &setBatchMode(InsertQuery::BatchMode mode, int maxChunkRows = 0)
+   {
+      m_query.setBatchMode(mode, maxChunkRows);
+
+      return *this;
+   }
+
+   /*!
+   \brief Sets function (lambda) called after each successful flush
+   */
+   InsertStream &onFlush(const std::function<void(const FlushInfo&)> &callback)
+   {
+      m_onFlush = callback;
+
+      return *this;
+   }
+
+   /*!
+   \brief Queues a row of insert-values, flushes the queued rows if a limit is reached
+
+   The method supports variable count of QVariant parameters.
+   \throws DBException on a failed flush
+   */
+   template <typename... Rest> InsertStream &values(const QVariant &first, const Rest&... rest)
+   {
+      m_query.values(first, rest...);
+
+      m_pendingBytes += valueBytes(first, rest...);
+      ++m_pendingRows;
+
+      if (m_pendingRows >= m_flushRows || (m_flushBytes > 0 && m_pendingBytes >= m_flushBytes))
+      {
+         flush();
+      }
+
+      return *this;
+   }
+
+   /*!
+   \brief Inserts queued rows
+   \returns false if the insert failed (with disabled exceptions), the queued rows are dropped in this case
+   \throws DBException
+   */
+   bool flush()
+   {
+      if (m_pendingRows == 0)
+         return true;
+
+      FlushInfo info;
+      info.rows = m_pendingRows;
+      info.bytes = m_pendingBytes;
+
+      m_pendingRows = 0;
+      m_pendingBytes = 0;
+
+      QElapsedTimer timer;
+      timer.start();
+
+      const NonQueryResult res = m_query.exec();
+
+      info.elapsed = timer.nsecsElapsed() / 1000;
+
+      m_lastError = res.lastError();
+
+      if (m_lastError.isValid())
+         return false;
+
+      m_totalRows += info.rows;
+      m_totalElapsed += info.elapsed;
+      ++m_flushCount;
+
+      info.totalRows = m_totalRows;
+      info.flushCount = m_flushCount;
+
+      if (m_onFlush)
+         m_onFlush(info);
+
+      return true;
+   }
+
+   /*!
+   \brief Returns count of queued rows
+   */
+   int pendingRows() const
+   {
+      return m_pendingRows;
+   }
+
+   /*!
+   \brief Returns count of rows written by all flushes
+   */
+   qint64 totalRows() const
+   {
+      return m_totalRows;
+   }
+
+   /*!
+   \brief Returns count of successful flushes
+   */
+   int flushCount() const
+   {
+      return m_flushCount;
+   }
+
+   /*!
+   \brief Returns total time of all successful flushes, us
+   */
+   qint64 totalElapsed() const
+   {
+      return m_totalElapsed;
+   }
+
+   /*!
+   \brief Returns error of the last flush
+   */
+   QSqlError lastError() const
+   {
+      return m_lastError;
+   }
+
+private:
+   InsertQuery m_query;
+
+   int m_flushRows;
+   qint64 m_flushBytes;
+
+   int m_pendingRows = 0;
+   qint64 m_pendingBytes = 0;
+
+   qint64 m_totalRows = 0;
+   qint64 m_totalElapsed = 0;
+   int m_flushCount = 0;
+
+   QSqlError m_lastError;
+
+   std::function<void(const FlushInfo&)> m_onFlush;
+
+   //estimated memory of a queued value
+   static qint64 valueBytes(const QVariant &value)
+   {
+      switch (value.type())
+      {
+      case QVariant::String:
+         return sizeof(QVariant) + value.toString().size() * qint64(sizeof(QChar));
+      case QVariant::ByteArray:
+         return sizeof(QVariant) + value.toByteArray().size();
+      default:
+         return sizeof(QVariant);
+      }
+   }
+
+   template <typename... Rest> static qint64 valueBytes(const QVariant &first, const QVariant &second, const Rest&... rest)
+   {
+      return valueBytes(first) + valueBytes(second, rest...);
+   }
+};
+
+#endif // EASYQTSQL_INSERTSTREAM_H
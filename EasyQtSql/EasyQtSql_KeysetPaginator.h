@@ -0,0 +1,374 @@
+#ifndef EASYQTSQL_KEYSETPAGINATOR_H
+#define EASYQTSQL_KEYSETPAGINATOR_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include "EasyQtSql_DBException.h"
+#include "EasyQtSql_QueryResult.h"
+#include "EasyQtSql_SqlDialect.h"
+#include "EasyQtSql_SqlFactory.h"
+
+#endif
+
+/*!
+\brief Keyset (seek) pagination over a SELECT query.
+
+Pages are selected with <em>WHERE (k1, k2) > (?, ?) ORDER BY k1, k2 LIMIT n</em>, where the bound values are the keys of the last row of the previous page.
+Unlike OFFSET pagination (Database::range), the server does not scan the skipped rows, so page N costs the same as page 1 (given an index on the keys).
+
+The base query is wrapped as a derived table, so the key columns are referenced by their result column names.
+The key columns must be unique together and not NULL, the base query must not have its own ORDER BY or LIMIT clause.
+Both page statements (the first page and the next pages) are prepared once and taken from the statement cache of the connection (see SqlFactory::prepareStatement).
+
+The position between pages is a cursor: the key values of the last handled row. It can be saved as an opaque token and restored later,
+e.g. to continue an export or to pass the position of a web page to the client.
+
+\code
+Database db;
+
+KeysetPaginator pages = db.paginate("SELECT id, name FROM table", QStringList() << "id", 100);
+
+while (!pages.atEnd())
+{
+   pages.nextPage([](const QueryResult &row)
+   {
+      qDebug() << row.toMap();
+   });
+}
+
+//resume later
+KeysetPaginator resumed = db.paginate("SELECT id, name FROM table", QStringList() << "id", 100);
+resumed.setCursorToken(token);
+\endcode
+\sa Database::paginate
+*/
+class KeysetPaginator
+{
+public:
+   /*!
+   \param query Base SELECT query
+   \param keyColumns Result columns of query the pages are ordered by
+   \param pageSize Max row count of a page
+   \param db Connection
+   \param order Sort order of all key columns
+   */
+   KeysetPaginator(const QString &query, const QStringList &keyColumns, int pageSize, const QSqlDatabase &db, Qt::SortOrder order = Qt::AscendingOrder)
+      : m_db(db)
+      , m_query(query.trimmed())
+      , m_keyColumns(keyColumns)
+      , m_pageSize(qMax(1, pageSize))
+      , m_order(order)
+   {
+      Q_ASSERT(!keyColumns.isEmpty());
+
+      while (m_query.endsWith(QLatin1Char(';')))
+      {
+         m_query.chop(1);
+      }
+   }
+
+   /*!
+   \brief Applies function (lambda) f to each row of the next page and moves the cursor to the last row.
+   \param f Function (lambda) with <em>const QueryResult &</em> argument
+   \returns num rows handled with function <em>f</em>, zero if there are no more rows
+   \throws DBException
+   */
+   template<typename Func>
+   int nextPage(Func&& f)
+   {
+      if (m_atEnd)
+         return 0;
+
+      const bool firstPage = m_cursor.isEmpty();
+
+      Page &page = preparedPage(firstPage);
+
+      if (!firstPage)
+      {
+         const QVariantList &values = bindValues();
+
+         for (int i = 0; i < values.count(); ++i)
+         {
+            page.query.bindValue(i, values.at(i));
+         }
+      }
+
+      const bool ok = page.query.exec();
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+      if (!ok)
+         throw DBException(page.query);
+
+#endif
+
+      if (!ok)
+         return 0;
+
+      QVector<int> keyIndexes(m_keyColumns.count());
+
+      const QSqlRecord record = page.query.record();
+
+      for (int i = 0; i < m_keyColumns.count(); ++i)
+      {
+         keyIndexes[i] = record.indexOf(m_keyColumns.at(i));
+
+         if (keyIndexes.at(i) < 0)
+         {
+            m_atEnd = true; //the cursor can not move
+
+#ifdef DB_EXCEPTIONS_ENABLED
+            throw DBException(QSqlError(QString(), QString("Key column %0 is not found in the query result").arg(m_keyColumns.at(i)), QSqlError::StatementError));
+#endif
+
+            return 0;
+         }
+      }
+
+      QueryResult res(page.query, QHash<QString, int>(), page.statement);
+
+      QVariantList cursor;
+      cursor.reserve(m_keyColumns.count());
+
+      int rowCount = 0;
+
+      while (rowCount < m_pageSize && res.next())
+      {
+         f(res);
+         ++rowCount;
+
+         cursor.clear();
+
+         for (int index : keyIndexes)
+         {
+            cursor.append(res.value(index));
+         }
+      }
+
+      page.query.finish();
+
+      if (rowCount > 0)
+         m_cursor = cursor;
+
+      m_atEnd = rowCount < m_pageSize;
+
+      return rowCount;
+   }
+
+   /*!
+   \brief Returns true if the last page was not full, so there are no more rows
+   */
+   bool atEnd() const
+   {
+      return m_atEnd;
+   }
+
+   /*!
+   \brief Returns max row count of a page
+   */
+   int pageSize() const
+   {
+      return m_pageSize;
+   }
+
+   /*!
+   \brief Returns key values of the last handled row. Empty list means the cursor is before the first row.
+   */
+   QVariantList cursor() const
+   {
+      return m_cursor;
+   }
+
+   /*!
+   \brief Moves the cursor after the row with key values <em>keys</em>. Empty list moves the cursor before the first row.
+   \returns false if the count of values does not match the count of key columns
+   */
+   bool setCursor(const QVariantList &keys)
+   {
+      if (!keys.isEmpty() && keys.count() != m_keyColumns.count())
+         return false;
+
+      m_cursor = keys;
+      m_atEnd = false;
+
+      return true;
+   }
+
+   /*!
+   \brief Returns the cursor serialized to a URL safe string
+   \sa KeysetPaginator::setCursorToken
+   */
+   QString cursorToken() const
+   {
+      QByteArray data;
+
+      QDataStream stream(&data, QIODevice::WriteOnly);
+      stream << quint8(TokenVersion) << m_cursor;
+
+      return QString::fromLatin1(data.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+   }
+
+   /*!
+   \brief Restores the cursor from token returned by KeysetPaginator::cursorToken
+   \returns false if the token is invalid or was created for another count of key columns
+   */
+   bool setCursorToken(const QString &token)
+   {
+      const QByteArray data = QByteArray::fromBase64(token.toLatin1(), QByteArray::Base64UrlEncoding);
+
+      QDataStream stream(data);
+
+      quint8 version = 0;
+      QVariantList keys;
+
+      stream >> version >> keys;
+
+      if (stream.status() != QDataStream::Ok || version != TokenVersion)
+         return false;
+
+      return setCursor(keys);
+   }
+
+   /*!
+   \brief Moves the cursor before the first row
+   */
+   void reset()
+   {
+      setCursor(QVariantList());
+   }
+
+private:
+   enum { TokenVersion = 1 };
+
+   struct Page
+   {
+      QSqlQuery query;
+      QSharedPointer<QSqlQuery> statement; //cached statement lease (see StatementCache)
+      bool prepared = false;
+   };
+
+   QSqlDatabase m_db;
+   QString m_query;
+   QStringList m_keyColumns;
+   int m_pageSize;
+   Qt::SortOrder m_order;
+
+   QVariantList m_cursor;
+   bool m_atEnd = false;
+
+   Page m_firstPage;
+   Page m_nextPage;
+
+   Page &preparedPage(bool firstPage)
+   {
+      Page &page = firstPage ? m_firstPage : m_nextPage;
+
+      if (!page.prepared)
+      {
+         page.statement = SqlFactory::prepareStatement(m_db, pageSql(firstPage), page.query);
+         page.prepared = true;
+      }
+
+      return page;
+   }
+
+   //SELECT * FROM (query) keyset_page WHERE keys > cursor ORDER BY keys, limited with the dialect clause
+   QString pageSql(bool firstPage) const
+   {
+      const SqlDialect dialect(m_db);
+
+      const QString direction = m_order == Qt::AscendingOrder ? QString() : QString(" DESC");
+      const QString compare = m_order == Qt::AscendingOrder ? QString(" > ") : QString(" < ");
+
+      QString sql = QString("SELECT * FROM (\n%0\n) keyset_page").arg(m_query);
+
+      if (!firstPage)
+      {
+         if (dialect.hasRowValues() && m_keyColumns.count() > 1)
+         {
+            QStringList params;
+
+            for (int i = 0; i < m_keyColumns.count(); ++i)
+            {
+               params.append(QLatin1String("?"));
+            }
+
+            sql += QString("\nWHERE (%0)%1(%2)").arg(m_keyColumns.join(", ")).arg(compare).arg(params.join(", "));
+         }
+         else
+         {
+            //k1 > ? OR (k1 = ? AND k2 > ?) OR ...
+            QStringList terms;
+
+            for (int i = 0; i < m_keyColumns.count(); ++i)
+            {
+               QStringList term;
+
+               for (int j = 0; j < i; ++j)
+               {
+                  term.append(m_keyColumns.at(j) + QLatin1String(" = ?"));
+               }
+
+               term.append(m_keyColumns.at(i) + compare + QLatin1String("?"));
+
+               terms.append(QString("(%0)").arg(term.join(" AND ")));
+            }
+
+            sql += QString("\nWHERE %0").arg(terms.join(" OR "));
+         }
+      }
+
+      sql += QString("\nORDER BY %0%1").arg(m_keyColumns.join(direction + QLatin1String(", "))).arg(direction);
+
+      const QString limitedSql = dialect.limitQuery(sql, m_pageSize);
+
+      return limitedSql.isEmpty() ? sql : limitedSql; //unknown dialect: the page is cut on the client side
+   }
+
+   //cursor values in the order of the WHERE clause parameters
+   QVariantList bindValues() const
+   {
+      if (SqlDialect(m_db).hasRowValues() || m_keyColumns.count() == 1)
+         return m_cursor;
+
+      QVariantList values;
+
+      for (int i = 0; i < m_keyColumns.count(); ++i)
+      {
+         for (int j = 0; j <= i; ++j)
+         {
+            values.append(m_cursor.at(j));
+         }
+      }
+
+      return values;
+   }
+};
+
+#endif // EASYQTSQL_KEYSETPAGINATOR_H
@@ -0,0 +1,378 @@
+#ifndef EASYQTSQL_METRICS_H
+#define EASYQTSQL_METRICS_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include <functional>
+
+#endif
+
+/*!
+\brief Lock-free histogram of durations (microseconds) with fixed exponential buckets
+*/
+class LatencyHistogram
+{
+   Q_DISABLE_COPY(LatencyHistogram)
+
+public:
+   enum { BucketCount = 16 };
+
+   LatencyHistogram()
+   { }
+
+   /*!
+   \brief Upper bounds (us) of the buckets, the last bucket has no upper bound (+Inf)
+   */
+   static qint64 upperBound(int bucket)
+   {
+      static const qint64 bounds[BucketCount - 1] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                                      100000, 250000, 500000, 1000000, 5000000, 10000000 };
+
+      return bucket < BucketCount - 1 ? bounds[bucket] : -1;
+   }
+
+   void record(qint64 usec)
+   {
+      int bucket = 0;
+
+      while (bucket < BucketCount - 1 && usec > upperBound(bucket))
+      {
+         ++bucket;
+      }
+
+      m_buckets[bucket].fetchAndAddRelaxed(1);
+      m_count.fetchAndAddRelaxed(1);
+      m_sum.fetchAndAddRelaxed(static_cast<quint64>(qMax<qint64>(0, usec)));
+   }
+
+   /*!
+   \brief Returns count of values in the bucket (not cumulative)
+   */
+   quint64 bucketCount(int bucket) const
+   {
+      return m_buckets[bucket].load();
+   }
+
+   quint64 count() const
+   {
+      return m_count.load();
+   }
+
+   /*!
+   \brief Returns sum of recorded values (us)
+   */
+   quint64 sum() const
+   {
+      return m_sum.load();
+   }
+
+private:
+   QAtomicInteger<quint64> m_buckets[BucketCount];
+   QAtomicInteger<quint64> m_count;
+   QAtomicInteger<quint64> m_sum;
+};
+
+/*!
+\brief Cumulative counters of a SqlFactory connection name. Updated lock-free by the connections and pools of the name.
+*/
+struct ConnectionMetrics
+{
+   QAtomicInteger<quint64> opens;            //!< successful connection opens
+   QAtomicInteger<quint64> openFailures;     //!< failed open attempts
+   QAtomicInteger<quint64> checkouts;        //!< successful pool checkouts
+   QAtomicInteger<quint64> checkoutTimeouts; //!< pool checkouts failed because the pool was exhausted
+   QAtomicInteger<quint64> cacheHits;        //!< statement cache hits
+   QAtomicInteger<quint64> cacheMisses;      //!< statement cache misses
+
+   LatencyHistogram openLatency;  //!< time to open and initialize a connection, us
+   LatencyHistogram checkoutWait; //!< time spent in pool checkout, us
+};
+
+/*!
+\brief Point-in-time copy of SqlFactory metrics, see SqlFactory::metrics.
+
+\code
+SqlFactory::getInstance()->exportMetrics("/var/lib/node_exporter/easyqtsql.prom", MetricsSnapshot::Prometheus);
+
+SqlFactory::getInstance()->exportMetrics([](const QByteArray &data)
+{
+   qDebug().noquote() << data;
+}, MetricsSnapshot::Json);
+\endcode
+*/
+class MetricsSnapshot
+{
+public:
+   enum Format
+   {
+      Json,       //!< JSON document
+      Prometheus  //!< Prometheus text exposition format
+   };
+
+   struct Histogram
+   {
+      QVector<quint64> buckets; //!< not cumulative counts, see LatencyHistogram::upperBound
+      quint64 count = 0;
+      quint64 sum   = 0;        //!< us
+   };
+
+   struct Connection
+   {
+      QString name;
+      bool pooled = false;
+
+      int open  = 0;       //!< open pooled connections (idle and checked out)
+      int idle  = 0;       //!< idle pooled connections
+      int inUse = 0;       //!< checked out pooled connections
+      int threadLocal = 0; //!< thread-local connections of all threads (not reaped)
+
+      quint64 opens = 0;
+      quint64 openFailures = 0;
+      quint64 checkouts = 0;
+      quint64 checkoutTimeouts = 0;
+      quint64 cacheHits = 0;
+      quint64 cacheMisses = 0;
+
+      Histogram openLatency;
+      Histogram checkoutWait;
+
+      /*!
+      \brief Returns statement cache hit rate (0..1), zero if the cache was not used
+      */
+      double cacheHitRate() const
+      {
+         const quint64 total = cacheHits + cacheMisses;
+
+         return total > 0 ? double(cacheHits) / double(total) : 0.0;
+      }
+   };
+
+   QList<Connection> connections;
+
+   static Histogram histogram(const LatencyHistogram &source)
+   {
+      Histogram res;
+
+      for (int i = 0; i < LatencyHistogram::BucketCount; ++i)
+      {
+         res.buckets.append(source.bucketCount(i));
+      }
+
+      res.count = source.count();
+      res.sum   = source.sum();
+
+      return res;
+   }
+
+   /*!
+   \brief Returns connection metrics of connectionName (default constructed if there is no such connection)
+   */
+   Connection connection(const QString &connectionName) const
+   {
+      for (const Connection &connection : connections)
+      {
+         if (connection.name == connectionName)
+            return connection;
+      }
+
+      return Connection();
+   }
+
+   QByteArray toJson(QJsonDocument::JsonFormat format = QJsonDocument::Indented) const
+   {
+      QJsonObject root;
+
+      for (const Connection &c : connections)
+      {
+         QJsonObject cache;
+         cache.insert("hits", double(c.cacheHits));
+         cache.insert("misses", double(c.cacheMisses));
+         cache.insert("hitRate", c.cacheHitRate());
+
+         QJsonObject obj;
+         obj.insert("pooled", c.pooled);
+         obj.insert("open", c.open);
+         obj.insert("idle", c.idle);
+         obj.insert("inUse", c.inUse);
+         obj.insert("threadLocal", c.threadLocal);
+         obj.insert("opens", double(c.opens));
+         obj.insert("openFailures", double(c.openFailures));
+         obj.insert("checkouts", double(c.checkouts));
+         obj.insert("checkoutTimeouts", double(c.checkoutTimeouts));
+         obj.insert("statementCache", cache);
+         obj.insert("openLatencyUs", histogramJson(c.openLatency));
+         obj.insert("checkoutWaitUs", histogramJson(c.checkoutWait));
+
+         root.insert(c.name, obj);
+      }
+
+      QJsonObject doc;
+      doc.insert("connections", root);
+
+      return QJsonDocument(doc).toJson(format);
+   }
+
+   QByteArray toPrometheus() const
+   {
+      QByteArray out;
+
+      gauge(out, "easyqtsql_pool_connections_open", "Open pooled connections", [](const Connection &c) { return double(c.open); });
+      gauge(out, "easyqtsql_pool_connections_idle", "Idle pooled connections", [](const Connection &c) { return double(c.idle); });
+      gauge(out, "easyqtsql_pool_connections_in_use", "Checked out pooled connections", [](const Connection &c) { return double(c.inUse); });
+      gauge(out, "easyqtsql_thread_connections", "Thread-local connections", [](const Connection &c) { return double(c.threadLocal); });
+
+      counter(out, "easyqtsql_connection_opens_total", "Opened connections", [](const Connection &c) { return c.opens; });
+      counter(out, "easyqtsql_connection_open_failures_total", "Failed connection open attempts", [](const Connection &c) { return c.openFailures; });
+      counter(out, "easyqtsql_pool_checkouts_total", "Pool checkouts", [](const Connection &c) { return c.checkouts; });
+      counter(out, "easyqtsql_pool_checkout_timeouts_total", "Pool checkouts failed on exhausted pool", [](const Connection &c) { return c.checkoutTimeouts; });
+      counter(out, "easyqtsql_statement_cache_hits_total", "Statement cache hits", [](const Connection &c) { return c.cacheHits; });
+      counter(out, "easyqtsql_statement_cache_misses_total", "Statement cache misses", [](const Connection &c) { return c.cacheMisses; });
+
+      histogramPrometheus(out, "easyqtsql_connection_open_seconds", "Connection open latency", [](const Connection &c) { return c.openLatency; });
+      histogramPrometheus(out, "easyqtsql_pool_checkout_wait_seconds", "Pool checkout wait time", [](const Connection &c) { return c.checkoutWait; });
+
+      return out;
+   }
+
+   /*!
+   \brief Returns the snapshot in format
+   */
+   QByteArray serialize(Format format) const
+   {
+      return format == Prometheus ? toPrometheus() : toJson();
+   }
+
+   /*!
+   \brief Writes the snapshot to fileName atomically (readers never see a partially written file)
+   */
+   bool writeToFile(const QString &fileName, Format format) const
+   {
+      QSaveFile file(fileName);
+
+      if (!file.open(QIODevice::WriteOnly))
+      {
+         qWarning() << "Cannot write metrics:" << file.errorString();
+
+         return false;
+      }
+
+      file.write(serialize(format));
+
+      return file.commit();
+   }
+
+private:
+   static QJsonObject histogramJson(const Histogram &h)
+   {
+      QJsonArray buckets;
+
+      for (int i = 0; i < h.buckets.count(); ++i)
+      {
+         QJsonObject bucket;
+         bucket.insert("le", LatencyHistogram::upperBound(i) < 0 ? QJsonValue("+Inf") : QJsonValue(double(LatencyHistogram::upperBound(i))));
+         bucket.insert("count", double(h.buckets.at(i)));
+
+         buckets.append(bucket);
+      }
+
+      QJsonObject obj;
+      obj.insert("buckets", buckets);
+      obj.insert("count", double(h.count));
+      obj.insert("sum", double(h.sum));
+
+      return obj;
+   }
+
+   static QByteArray label(const QString &connectionName)
+   {
+      QString escaped = connectionName;
+      escaped.replace("\\", "\\\\");
+      escaped.replace("\"", "\\\"");
+      escaped.replace("\n", "\\n");
+
+      return "connection=\"" + escaped.toUtf8() + "\"";
+   }
+
+   static void header(QByteArray &out, const char *name, const char *help, const char *type)
+   {
+      out += QByteArray("# HELP ") + name + " " + help + "\n";
+      out += QByteArray("# TYPE ") + name + " " + type + "\n";
+   }
+
+   template<typename Func>
+   void gauge(QByteArray &out, const char *name, const char *help, Func value) const
+   {
+      header(out, name, help, "gauge");
+
+      for (const Connection &c : connections)
+      {
+         out += QByteArray(name) + "{" + label(c.name) + "} " + QByteArray::number(value(c)) + "\n";
+      }
+   }
+
+   template<typename Func>
+   void counter(QByteArray &out, const char *name, const char *help, Func value) const
+   {
+      header(out, name, help, "counter");
+
+      for (const Connection &c : connections)
+      {
+         out += QByteArray(name) + "{" + label(c.name) + "} " + QByteArray::number(value(c)) + "\n";
+      }
+   }
+
+   template<typename Func>
+   void histogramPrometheus(QByteArray &out, const char *name, const char *help, Func histogram) const
+   {
+      header(out, name, help, "histogram");
+
+      for (const Connection &c : connections)
+      {
+         const Histogram h = histogram(c);
+
+         quint64 cumulative = 0;
+
+         for (int i = 0; i < h.buckets.count(); ++i)
+         {
+            cumulative += h.buckets.at(i);
+
+            const qint64 bound = LatencyHistogram::upperBound(i);
+
+            const QByteArray le = bound < 0 ? QByteArray("+Inf") : QByteArray::number(double(bound) / 1000000.0);
+
+            out += QByteArray(name) + "_bucket{" + label(c.name) + ",le=\"" + le + "\"} " + QByteArray::number(cumulative) + "\n";
+         }
+
+         out += QByteArray(name) + "_sum{" + label(c.name) + "} " + QByteArray::number(double(h.sum) / 1000000.0) + "\n";
+         out += QByteArray(name) + "_count{" + label(c.name) + "} " + QByteArray::number(h.count) + "\n";
+      }
+   }
+};
+
+#endif // EASYQTSQL_METRICS_H
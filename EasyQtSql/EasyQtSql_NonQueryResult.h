@@ -73,14 +73,25 @@ public:
       return m_query.lastInsertId();
    }
 
+   /*!
+   \brief Returns keys of the rows inserted by InsertQuery in order of the inserted rows.
+
+   The keys are retrieved only if requested with InsertQuery::returningIds, the vector is empty otherwise.
+   Invalid QVariant is returned for a row whose key could not be determined.
+   */
+   QVector<QVariant> insertedIds() const
+   {
+      return m_insertedIds;
+   }
+
    /*!
    \brief Returns error information about the last error (if any) that occurred with this query.
 
-   Wrapper over QSqlQuery::lastError()
+   Wrapper over QSqlQuery::lastError(), or the error of a query rejected before execution (see InsertQuery::fromGadgets)
    */
    QSqlError lastError() const
    {
-      return m_query.lastError();
+      return m_error.isValid() ? m_error : m_query.lastError();
    }
 
    /*!
@@ -104,11 +115,15 @@ public:
    }
 
 private:
-   explicit NonQueryResult(const QSqlQuery &q)
+   explicit NonQueryResult(const QSqlQuery &q, const QSharedPointer<QSqlQuery> &statement = QSharedPointer<QSqlQuery>())
     : m_query(q)
+    , m_statement(statement)
    { }
 
    QSqlQuery m_query;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
+   QVector<QVariant> m_insertedIds;
+   QSqlError m_error; //error of a query rejected before execution
 };
 
 #endif // EASYQTSQL_NONQUERYRESULT_H
@@ -0,0 +1,379 @@
+#ifndef EASYQTSQL_PREFETCHRESULT_H
+#define EASYQTSQL_PREFETCHRESULT_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include "EasyQtSql_DBException.h"
+#include "EasyQtSql_ValueConverter.h"
+#include "EasyQtSql_SqlFactory.h"
+
+#endif
+
+/*!
+\brief Query result fetched ahead by a background producer thread.
+
+The producer thread takes its own (thread-local) SqlFactory connection, executes the query and fills a bounded ring buffer
+of decoded row batches. The consumer reads the rows with PrefetchResult::next as with QueryResult, so fetching of the next
+batches overlaps with processing of the current one. The producer waits when the buffer is full (backpressure),
+the consumer waits when it is empty.
+
+\code
+SqlFactory::getInstance()->config(SqlFactory::DBSetting("QPSQL", "db", 5432, "user", "password", "dwh"), "dwh");
+
+PrefetchResult res("SELECT id, payload FROM events WHERE day = ?", {QDate::currentDate()}, "dwh");
+
+while (res.next())
+{
+   process(res.get<qint64>(0), res.value(1).toByteArray());
+}
+\endcode
+
+\warning The query runs on another connection, outside of the caller's transaction.
+The connection name must be configured with SqlFactory::config.
+Each PrefetchResult starts a new producer thread which opens a new thread-local connection (and closes it when the producer finishes).
+With SqlFactory::DBSetting::sqliteInmemory() settings the connection is a separate, empty in-memory database:
+use a file or a shared in-memory database (SqlFactory::DBSetting::sqliteSharedInmemory) instead.
+*/
+class PrefetchResult
+{
+   Q_DISABLE_COPY(PrefetchResult)
+
+public:
+   /*!
+   \brief Starts the producer thread executing sql with positionally bound params
+   \param sql Select query
+   \param params Positional parameters of the query
+   \param connectionName SqlFactory connection name
+   \param batchSize Count of rows in a batch
+   \param bufferBatches Max count of fetched batches waiting for the consumer
+   */
+   PrefetchResult(const QString &sql, const QVariantList &params = QVariantList(), const QString &connectionName = QSqlDatabase::defaultConnection, int batchSize = 1000, int bufferBatches = 4)
+      : m_sql(sql)
+      , m_params(params)
+      , m_connectionName(connectionName)
+      , m_batchSize(qMax(1, batchSize))
+      , m_bufferBatches(qMax(1, bufferBatches))
+      , m_producer(this)
+   {
+      m_producer.start();
+   }
+
+   /*!
+   \brief Stops the producer thread (if the result is not drained) and waits for it
+   */
+   ~PrefetchResult()
+   {
+      cancel();
+
+      m_producer.wait();
+   }
+
+   /*!
+   \brief Retrieves the next row. Waits for the producer if no fetched row is buffered.
+   \return false if there are no more rows or the query failed (see PrefetchResult::lastError)
+   */
+   bool next()
+   {
+      if (++m_currentRow < m_current.rowCount)
+         return true;
+
+      QMutexLocker locker(&m_mutex);
+
+      if (!m_current.values.isEmpty())
+      {
+         m_free.append(m_current.values); //the drained buffer is reused by the producer
+         m_current = Batch();
+      }
+
+      while (m_ready.isEmpty() && !m_finished)
+      {
+         m_notEmpty.wait(&m_mutex);
+      }
+
+      if (m_ready.isEmpty())
+      {
+         m_currentRow = 0;
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+         if (m_error.isValid() && !m_cancelled)
+            throw DBException(m_error);
+
+#endif
+
+         return false;
+      }
+
+      m_current = m_ready.dequeue();
+      m_currentRow = 0;
+
+      m_notFull.wakeOne();
+
+      return true;
+   }
+
+   /*!
+   \brief Returns the value of column in the current row
+   */
+   QVariant value(int column) const
+   {
+      if (column < 0 || column >= m_columnCount || m_currentRow >= m_current.rowCount)
+         return QVariant();
+
+      return m_current.values.at(m_currentRow * m_columnCount + column);
+   }
+
+   /*!
+   \brief Returns the value of the field called name (case insensitive) in the current row
+   */
+   QVariant value(const QString &colName) const
+   {
+      return value(m_columnIndex.value(colName.toLower(), -1));
+   }
+
+   /*!
+   \brief Returns the value of column in the current row converted to type T with ValueConverter<T>
+   */
+   template<typename T>
+   T get(int column) const
+   {
+      return ValueConverter<T>::convert(value(column));
+   }
+
+   /*!
+   \brief Returns the first sizeof...(Ts) values of the current row converted to types Ts
+   \sa QueryResult::get
+   */
+   template<typename... Ts>
+   std::tuple<Ts...> get() const
+   {
+      return getTuple<Ts...>(typename MakeIndexSequence<sizeof...(Ts)>::type());
+   }
+
+   /*!
+   \brief Returns result column names. The names are known after the first PrefetchResult::next call.
+   */
+   QStringList fieldNames() const
+   {
+      return m_fieldNames;
+   }
+
+   /*!
+   \brief Returns error of the query execution or fetch (if any)
+   */
+   QSqlError lastError() const
+   {
+      QMutexLocker locker(&m_mutex);
+
+      return m_error;
+   }
+
+   /*!
+   \brief Stops the producer. PrefetchResult::next returns the rows already buffered only.
+   */
+   void cancel()
+   {
+      QMutexLocker locker(&m_mutex);
+
+      m_cancelled = true;
+
+      m_notFull.wakeAll();
+   }
+
+private:
+   struct Batch
+   {
+      Batch()
+         : rowCount(0)
+      { }
+
+      QVector<QVariant> values; //row-major: rowCount * column count values
+      int rowCount;
+   };
+
+   class Producer : public QThread
+   {
+   public:
+      explicit Producer(PrefetchResult *result)
+         : m_result(result)
+      { }
+
+      void run() override
+      {
+         m_result->produce();
+
+         SqlFactory::getInstance()->releaseThreadConnections(); //closes the connection of the producer thread
+      }
+
+   private:
+      PrefetchResult *m_result;
+   };
+
+   void produce()
+   {
+      QSqlDatabase db = SqlFactory::getInstance()->getDatabase(m_connectionName);
+
+      if (!db.isValid())
+      {
+         finish(QSqlError(QString(), QString("Connection %0 is not configured").arg(m_connectionName), QSqlError::ConnectionError));
+         return;
+      }
+
+      QSqlQuery query(db);
+      query.setForwardOnly(true);
+
+      bool ok = query.prepare(m_sql);
+
+      for (int i = 0; ok && i < m_params.count(); ++i)
+      {
+         query.bindValue(i, m_params.at(i));
+      }
+
+      ok = ok && query.exec();
+
+      if (!ok)
+      {
+         finish(query.lastError());
+         return;
+      }
+
+      const QSqlRecord record = query.record();
+      const int columnCount = record.count();
+
+      {
+         QMutexLocker locker(&m_mutex);
+
+         //published before the first batch, read by the consumer after it
+         m_columnCount = columnCount;
+
+         for (int i = 0; i < columnCount; ++i)
+         {
+            m_fieldNames.append(record.fieldName(i));
+
+            if (!m_columnIndex.contains(record.fieldName(i).toLower()))
+               m_columnIndex.insert(record.fieldName(i).toLower(), i);
+         }
+      }
+
+      bool hasRows = true;
+
+      while (hasRows)
+      {
+         Batch batch;
+
+         {
+            QMutexLocker locker(&m_mutex);
+
+            if (m_cancelled)
+               break;
+
+            if (!m_free.isEmpty())
+               batch.values = m_free.takeLast();
+         }
+
+         batch.values.resize(m_batchSize * columnCount); //a recycled buffer keeps its capacity
+
+         QVariant *values = batch.values.data();
+
+         while (batch.rowCount < m_batchSize && (hasRows = query.next()))
+         {
+            for (int i = 0; i < columnCount; ++i)
+            {
+               *values++ = query.value(i);
+            }
+
+            ++batch.rowCount;
+         }
+
+         if (batch.rowCount == 0)
+            break;
+
+         QMutexLocker locker(&m_mutex);
+
+         while (m_ready.count() >= m_bufferBatches && !m_cancelled)
+         {
+            m_notFull.wait(&m_mutex);
+         }
+
+         if (m_cancelled)
+            break;
+
+         m_ready.enqueue(batch);
+
+         m_notEmpty.wakeOne();
+      }
+
+      finish(query.lastError()); //QSqlQuery::next returns false on fetch errors too
+   }
+
+   void finish(const QSqlError &error)
+   {
+      QMutexLocker locker(&m_mutex);
+
+      if (error.type() != QSqlError::NoError)
+         m_error = error;
+
+      m_finished = true;
+
+      m_notEmpty.wakeAll();
+   }
+
+   template<typename... Ts, int... Indexes>
+   std::tuple<Ts...> getTuple(IndexSequence<Indexes...>) const
+   {
+      return std::tuple<Ts...>(ValueConverter<Ts>::convert(value(Indexes))...);
+   }
+
+   const QString m_sql;
+   const QVariantList m_params;
+   const QString m_connectionName;
+   const int m_batchSize;
+   const int m_bufferBatches;
+
+   mutable QMutex m_mutex;
+   QWaitCondition m_notEmpty;
+   QWaitCondition m_notFull;
+   QQueue<Batch> m_ready;              //fetched batches waiting for the consumer
+   QList<QVector<QVariant>> m_free;    //drained buffers to be refilled
+   bool m_finished = false;
+   bool m_cancelled = false;
+   QSqlError m_error;
+
+   int m_columnCount = 0;
+   QStringList m_fieldNames;
+   QHash<QString, int> m_columnIndex;
+
+   //consumer side
+   Batch m_current;
+   int m_currentRow = 0;
+
+   Producer m_producer;
+};
+
+#endif // EASYQTSQL_PREFETCHRESULT_H
@@ -31,6 +31,8 @@
 #include <QtSql>
 #include "EasyQtSql_QueryResult.h"
 #include "EasyQtSql_ParamDirectionWrapper.h"
+#include "EasyQtSql_SqlFactory.h"
+#include "EasyQtSql_SqlDialect.h"
 
 #endif
 
@@ -65,15 +67,22 @@ class  PreparedQuery
 public:
    PreparedQuery(const QString &stmt, const QSqlDatabase &db, bool forwardOnly = true)
       :m_query(db)
+      ,m_readOnly(SqlDialect::isReadOnly(stmt))
    {
-      m_query.setForwardOnly(forwardOnly);
-      m_query.prepare(stmt);
+      m_statement = SqlFactory::prepareStatement(db, stmt, m_query, forwardOnly);
+      m_connectionLease = SqlFactory::leaseConnection(db);
    }
 
    QueryResult &exec()
    {
       m_index = 0;
 
+      //statements other than read-only ones (see SqlDialect::isReadOnly) may modify data or lock rows
+      SqlFactory::WriteLock writeLock(m_readOnly ? nullptr : m_query.driver());
+
+      if (!m_readOnly)
+         SqlFactory::markWrite();
+
       const bool res = m_query.exec();
 
 #ifdef DB_EXCEPTIONS_ENABLED
@@ -83,7 +92,8 @@ public:
 
 #endif
 
-      m_result = QueryResult(m_query, m_aliases);
+      m_result = QueryResult(m_query, m_aliases, m_statement);
+      m_result.m_connectionLease = m_connectionLease;
 
       m_aliases.clear();
 
@@ -168,12 +178,16 @@ public:
 
 private:
    QSqlQuery m_query;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
+   QSharedPointer<QAtomicInt> m_connectionLease; //see SqlFactory::leaseConnection
+
+   bool m_readOnly = false;
 
    int m_index = 0;
 
    QueryResult m_result;
 
-   QMap<QString, int> m_aliases;
+   QHash<QString, int> m_aliases;
 
    void addAliasIfSet(const ParamDirectionWrapper &paramWrapper, int index)
    {
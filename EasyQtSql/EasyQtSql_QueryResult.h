@@ -29,7 +29,10 @@
 #ifndef EASY_QT_SQL_MAIN
 
 #include <QtSql>
+#include <iterator>
 #include "EasyQtSql_NonQueryResult.h"
+#include "EasyQtSql_ValueConverter.h"
+#include "EasyQtSql_ColumnBatch.h"
 
 #endif
 
@@ -41,9 +44,293 @@ class  QueryResult
    friend class Database;
    friend class Transaction;
    friend class PreparedQuery;   
+   friend class KeysetPaginator;
 
 public:
 
+   /*!
+   \brief Resolved result column handle.
+
+   The handle keeps the column index resolved once by QueryResult::column, so the named access does not look up the column name on every row.
+
+   \code
+   QueryResult res = t.execQuery("SELECT a, b FROM table");
+
+   const QueryResult::Column colA = res.column("a");
+
+   while (res.next())
+   {
+      int a = res.value(colA).toInt();
+   }
+   \endcode
+
+   \sa QueryResult::column, QueryResult::value(const Column&) const
+   */
+   class Column
+   {
+      friend class QueryResult;
+
+   public:
+      Column()
+       : m_index(-1)
+      { }
+
+      /*!
+      \brief Returns true if the column exists in the result set
+      */
+      bool isValid() const
+      {
+         return m_index >= 0;
+      }
+
+      /*!
+      \brief Returns index of the column in the result set or -1 if the column does not exist
+      */
+      int index() const
+      {
+         return m_index;
+      }
+
+      /*!
+      \brief Returns the name the column was resolved by
+      */
+      QString name() const
+      {
+         return m_name;
+      }
+
+   private:
+      Column(const QString &name, int index)
+       : m_name(name)
+       , m_index(index)
+      { }
+
+      QString m_name;
+      int m_index;
+   };
+
+   /*!
+   \brief Lightweight view of the current row of QueryResult, yielded by QueryResult::begin / QueryResult::end iterators.
+
+   The view does not copy the row. Values are read from the underlying query on access,
+   QueryResult::RowView::values and QueryResult::RowView::strings fill buffers reused for all the rows of the result,
+   so a full scan does no per-row container allocation.
+
+   \code
+   QueryResult res = t.execQuery("SELECT id, name FROM goods");
+
+   for (const QueryResult::RowView &row : res)
+   {
+      qint64 id = row.get<qint64>(0);
+      const QStringList &strings = row.strings(); //valid until the next row
+   }
+   \endcode
+
+   \warning The view and the buffers returned by it are valid until the iterator is advanced.
+   */
+   class RowView
+   {
+      friend class QueryResult;
+
+   public:
+      /*!
+      \brief Returns the value of column in the row
+      */
+      QVariant value(int column) const
+      {
+         return m_result->value(column);
+      }
+
+      /*!
+      \brief Returns the value of the field called name in the row
+      */
+      QVariant value(const QString &colName) const
+      {
+         return m_result->value(colName);
+      }
+
+      /*!
+      \brief Returns the value of the resolved column in the row
+      */
+      QVariant value(const Column &column) const
+      {
+         return m_result->value(column);
+      }
+
+      /*!
+      \brief Returns the value of column converted to type T with ValueConverter<T>
+      */
+      template<typename T>
+      T get(int column) const
+      {
+         return ValueConverter<T>::convert(m_result->value(column));
+      }
+
+      /*!
+      \brief Returns the first sizeof...(Ts) values of the row converted to types Ts
+      \sa QueryResult::get
+      */
+      template<typename... Ts>
+      std::tuple<Ts...> get() const
+      {
+         return m_result->get<Ts...>();
+      }
+
+      /*!
+      \brief Returns true if the value of column is SQL NULL
+      */
+      bool isNull(int column) const
+      {
+         return m_result->m_query.isNull(column);
+      }
+
+      /*!
+      \brief Returns count of columns in the row
+      */
+      int count() const
+      {
+         return m_result->m_fieldNames.count();
+      }
+
+      /*!
+      \brief Returns values of the row. The buffer is owned by QueryResult and reused for all the rows.
+      */
+      const QVector<QVariant> &values() const
+      {
+         m_result->fetchVector(m_result->m_rowValues);
+
+         return m_result->m_rowValues;
+      }
+
+      /*!
+      \brief Returns values of the row converted to QString. The buffer is owned by QueryResult and reused for all the rows.
+      */
+      const QStringList &strings() const
+      {
+         m_result->fetchStringList(m_result->m_rowStrings);
+
+         return m_result->m_rowStrings;
+      }
+
+      /*!
+      \brief Fills caller's list with values of the row, the list is reused (see QueryResult::fetchList)
+      */
+      void fetchList(QVariantList &list) const
+      {
+         m_result->fetchList(list);
+      }
+
+      /*!
+      \brief Fills caller's vector with values of the row, the vector is reused (see QueryResult::fetchVector)
+      */
+      void fetchVector(QVector<QVariant> &vector) const
+      {
+         m_result->fetchVector(vector);
+      }
+
+      /*!
+      \brief Fills caller's list with values of the row converted to QString, the list is reused (see QueryResult::fetchStringList)
+      */
+      void fetchStringList(QStringList &list) const
+      {
+         m_result->fetchStringList(list);
+      }
+
+      /*!
+      \brief Returns QueryResult positioned on the row
+      */
+      const QueryResult &result() const
+      {
+         return *m_result;
+      }
+
+   private:
+      explicit RowView(QueryResult *result)
+       : m_result(result)
+      { }
+
+      QueryResult *m_result;
+   };
+
+   /*!
+   \brief Forward (input) iterator over the rows of QueryResult
+   \sa QueryResult::begin, QueryResult::RowView
+   */
+   class RowIterator
+   {
+      friend class QueryResult;
+
+   public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef RowView value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const RowView *pointer;
+      typedef const RowView &reference;
+
+      reference operator*() const
+      {
+         return m_view;
+      }
+
+      pointer operator->() const
+      {
+         return &m_view;
+      }
+
+      RowIterator &operator++()
+      {
+         if (!m_view.m_result->next())
+            m_view.m_result = nullptr;
+
+         return *this;
+      }
+
+      bool operator==(const RowIterator &other) const
+      {
+         return m_view.m_result == other.m_view.m_result;
+      }
+
+      bool operator!=(const RowIterator &other) const
+      {
+         return m_view.m_result != other.m_view.m_result;
+      }
+
+   private:
+      explicit RowIterator(QueryResult *result)
+       : m_view(result)
+      { }
+
+      RowView m_view;
+   };
+
+   typedef RowIterator iterator;
+
+   /*!
+   \brief Fetches the next row and returns iterator positioned on it (or QueryResult::end if there are no more rows).
+
+   The iterators refer to the QueryResult, so keep the result in a variable for the loop:
+   \code
+   QueryResult res = t.execQuery("SELECT a, b FROM table");
+
+   for (const auto &row : res)
+   {
+      qDebug() << row.get<int>(0) << row.value(1);
+   }
+   \endcode
+   */
+   RowIterator begin()
+   {
+      return RowIterator(next() ? this : nullptr);
+   }
+
+   /*!
+   \brief Returns past-the-last-row iterator
+   */
+   RowIterator end()
+   {
+      return RowIterator(nullptr);
+   }
+
    /*!
    \brief Returns reference on wrapped QSqlQuery.
    */
@@ -72,6 +359,9 @@ public:
             m_fieldNames.append(record.fieldName(i));
          }
 
+         m_columnIndex.clear(); //rebuilt from m_fieldNames on the first named access
+         m_fetchPlans.clear();
+
          m_firstRowFetched = true;
       }
 
@@ -97,6 +387,9 @@ public:
    {
       m_firstRowFetched = false;
 
+      m_columnIndex.clear();
+      m_fetchPlans.clear();
+
       bool res = m_query.nextResult();
 
       return res;
@@ -236,11 +529,37 @@ public:
    /*!
    \brief Returns the value of the field called name in the current record. If field name does not exist an invalid variant is returned.
 
-   Wrapper over QSqlQuery::value()
+   The name is resolved with the hashed name-to-index table of the result set (see QueryResult::column),
+   use QueryResult::Column handle to skip the lookup completely.
    */
    QVariant value(const QString &colName) const
    {
-      return m_query.value(colName);
+      const int index = columnIndex(colName);
+
+      return index >= 0 ? m_query.value(index) : QVariant();
+   }
+
+   /*!
+   \brief Returns the value of the resolved column in the current record. If the column does not exist an invalid variant is returned.
+   \sa QueryResult::column
+   */
+   QVariant value(const Column &column) const
+   {
+      return column.isValid() ? m_query.value(column.index()) : QVariant();
+   }
+
+   /*!
+   \brief Resolves result column by name and returns its handle.
+
+   Column names are matched the same way QSqlRecord::indexOf does (case insensitive, optional "table." prefix).
+   The name-to-index table is built once per result set, so resolving is a single hash lookup.
+   The handle stays valid until QueryResult::nextResult is called.
+
+   \sa QueryResult::Column
+   */
+   Column column(const QString &colName) const
+   {
+      return Column(colName, columnIndex(colName));
    }
 
    /*!
@@ -264,7 +583,12 @@ public:
    */
    QVariant boundValue(const QString &aliasName) const
    {
-      const int index = m_bindValueAlias.value(aliasName.trimmed().toLower(), -1);
+      int index = m_bindValueAlias.value(aliasName, -1); //exact match: aliases are stored trimmed (and lowercased for ::In)
+
+      if (index < 0)
+      {
+         index = m_bindValueAlias.value(aliasName.trimmed().toLower(), -1);
+      }
 
       QVariant res;
 
@@ -484,7 +808,7 @@ public:
    */
    void fetchVars(double &value) const
    {
-      value = m_query.value(m_fetchIndex).toInt();
+      value = m_query.value(m_fetchIndex).toDouble();
 
       m_fetchIndex = 0;
    }
@@ -636,6 +960,111 @@ public:
       fetchVars(rest...);
    }
 
+   /*!
+   \brief Returns std::tuple of the first sizeof...(Ts) values of the current record converted to types Ts.
+
+   Column indexes are resolved at compile time and each value is converted with ValueConverter<T> (QVariant::to*() methods),
+   std::optional<T> (C++17) receives std::nullopt for SQL NULL values.
+
+   \code
+   QueryResult res = t.execQuery("SELECT id, name, price FROM goods");
+
+   while (res.next())
+   {
+      qint64 id;
+      QString name;
+      std::optional<double> price;
+
+      std::tie(id, name, price) = res.get<qint64, QString, std::optional<double>>();
+   }
+   \endcode
+
+   \sa ValueConverter, QueryResult::fetchInto
+   */
+   template<typename... Ts>
+   std::tuple<Ts...> get() const
+   {
+      return getTuple<Ts...>(typename MakeIndexSequence<sizeof...(Ts)>::type());
+   }
+
+   /*!
+   \brief Assigns elements of tuple the values of the current record (the first element gets the first column value and so on).
+
+   \code
+   std::tuple<int, QString> row;
+   res.fetchInto(row);
+   \endcode
+
+   \sa QueryResult::get
+   */
+   template<typename... Ts>
+   void fetchInto(std::tuple<Ts...> &tuple) const
+   {
+      fetchTuple(tuple, typename MakeIndexSequence<sizeof...(Ts)>::type());
+   }
+
+   /*!
+   \brief Assigns the variables tied with std::tie the values of the current record.
+
+   \code
+   int a;
+   QString d;
+   res.fetchInto(std::tie(a, d));
+   \endcode
+   */
+   template<typename... Ts>
+   void fetchInto(std::tuple<Ts...> &&tuple) const
+   {
+      fetchTuple(tuple, typename MakeIndexSequence<sizeof...(Ts)>::type());
+   }
+
+   /*!
+   \brief Assigns struct members the values of the current record. Member pointers are listed in the column order.
+
+   \code
+   struct Goods
+   {
+      qint64 id;
+      QString name;
+      double price;
+   };
+
+   Goods goods;
+   res.fetchInto(goods, &Goods::id, &Goods::name, &Goods::price);
+   \endcode
+   */
+   template<typename T, typename... Ms>
+   void fetchInto(T &object, Ms T::*... members) const
+   {
+      fetchMembers(object, typename MakeIndexSequence<sizeof...(Ms)>::type(), members...);
+   }
+
+   /*!
+   \brief Assigns struct members the values of the current record. The struct lists its members in the column order with tie() method.
+
+   \code
+   struct Goods
+   {
+      qint64 id;
+      QString name;
+      double price;
+
+      std::tuple<qint64&, QString&, double&> tie()
+      {
+         return std::tie(id, name, price);
+      }
+   };
+
+   Goods goods;
+   res.fetchInto(goods);
+   \endcode
+   */
+   template<typename T>
+   auto fetchInto(T &object) const -> decltype(object.tie(), void())
+   {
+      fetchInto(object.tie());
+   }
+
    /*!
    \brief Fills Q_OBJECT object properties with data fetched from current result row.
 
@@ -681,28 +1110,17 @@ public:
 
    \endcode
 
+   The property-to-column mapping is computed once per result set and object class, so the rows are filled by index.
+
    \param object Q_OBJECT object reference
    */
    void fetchObject(QObject &object) const
    {
-      const QMetaObject *metaobject = object.metaObject();
-      const int count = metaobject->propertyCount();
+      const FetchPlan &plan = fetchPlan(object.metaObject());
 
-      const QVariantMap map = toMap();
-
-      for (int i = 0; i < count; ++i)
+      for (const PropertyColumn &item : plan)
       {
-         QMetaProperty metaproperty = metaobject->property(i);
-
-         if (metaproperty.isWritable())
-         {
-            QLatin1String sName(metaproperty.name());
-
-            if (map.contains(sName))
-            {
-               object.setProperty(sName.data(), map.value(sName));
-            }
-         }
+         item.property.write(&object, m_query.value(item.column));
       }
    }
 
@@ -752,30 +1170,18 @@ public:
 
    \endcode
 
+   The property-to-column mapping is computed once per result set and gadget type, so the rows are filled by index.
+
    \param gadget Q_GADGET reference
    */
    template<typename T>
    void fetchGadget(T &gadget) const
    {
-      const QMetaObject &metaobject = gadget.staticMetaObject;
+      const FetchPlan &plan = fetchPlan(&gadget.staticMetaObject);
 
-      const int count = metaobject.propertyCount();
-
-      const QVariantMap map = toMap();
-
-      for (int i = 0; i < count; ++i)
+      for (const PropertyColumn &item : plan)
       {
-         QMetaProperty metaproperty = metaobject.property(i);
-
-         if (metaproperty.isWritable())
-         {
-            QLatin1String sName(metaproperty.name());
-
-            if (map.contains(sName))
-            {
-               metaproperty.writeOnGadget(&gadget, map.value(sName));
-            }
-         }
+         item.property.writeOnGadget(&gadget, m_query.value(item.column));
       }
    }
 
@@ -801,11 +1207,25 @@ public:
    */
    void fetchList(QVariantList &list) const
    {
-      list.clear();
+      const int count = m_fieldNames.count();
 
-      for (int i = 0; i < m_fieldNames.count(); ++i)
+      if (list.count() != count)
+      {
+         list.clear();
+         list.reserve(count);
+
+         for (int i = 0; i < count; ++i)
+         {
+            list.append(m_query.value(i));
+         }
+      }
+      else
       {
-         list.append(m_query.value(i));
+         //same row shape: elements are overwritten in place, the list is not reallocated
+         for (int i = 0; i < count; ++i)
+         {
+            list[i] = m_query.value(i);
+         }
       }
    }
 
@@ -816,12 +1236,13 @@ public:
    */
    void fetchVector(QVector<QVariant> &vector) const
    {
-      vector.clear();
-      vector.reserve(m_fieldNames.count());
+      const int count = m_fieldNames.count();
 
-      for (int i = 0; i < m_fieldNames.count(); ++i)
+      vector.resize(count); //keeps the capacity of the reused vector
+
+      for (int i = 0; i < count; ++i)
       {
-         vector.append(m_query.value(i));
+         vector[i] = m_query.value(i);
       }
    }
 
@@ -832,12 +1253,60 @@ public:
    */
    void fetchStringList(QStringList &list) const
    {
-      list.clear();
+      const int count = m_fieldNames.count();
 
-      for (int i = 0; i < m_fieldNames.count(); ++i)
+      if (list.count() != count)
       {
-         list.append(m_query.value(i).toString());
+         list.clear();
+         list.reserve(count);
+
+         for (int i = 0; i < count; ++i)
+         {
+            list.append(m_query.value(i).toString());
+         }
       }
+      else
+      {
+         //same row shape: elements are overwritten in place, the list is not reallocated
+         for (int i = 0; i < count; ++i)
+         {
+            list[i] = m_query.value(i).toString();
+         }
+      }
+   }
+
+   /*!
+   \brief Fetches up to batchSize next rows into typed column buffers (struct of arrays).
+
+   The fetch starts with the row after the current one, so the current row is left when the method returns.
+   Buffers of the batch are reused: pass the same batch to the subsequent calls to avoid reallocations.
+
+   \return Count of fetched rows, 0 if there are no more rows
+   \sa ColumnBatch
+   */
+   int fetchColumns(ColumnBatch &batch, int batchSize)
+   {
+      batch.reset(m_query.record(), qMax(0, batchSize));
+
+      while (batch.rowCount() < batchSize && next())
+      {
+         batch.appendRow(m_query);
+      }
+
+      return batch.rowCount();
+   }
+
+   /*!
+   \brief Returns up to batchSize next rows stored in typed column buffers (struct of arrays). Empty batch is returned if there are no more rows.
+   \sa QueryResult::fetchColumns(ColumnBatch&, int)
+   */
+   ColumnBatch fetchColumns(int batchSize)
+   {
+      ColumnBatch batch;
+
+      fetchColumns(batch, batchSize);
+
+      return batch;
    }
 
 private:
@@ -849,15 +1318,142 @@ private:
     : m_query(query)
    { }
 
-   QueryResult(const QSqlQuery &query, const QMap<QString, int> &bindValueAliasMap)
+   QueryResult(const QSqlQuery &query, const QHash<QString, int> &bindValueAliasMap, const QSharedPointer<QSqlQuery> &statement = QSharedPointer<QSqlQuery>())
     : m_query(query)
     , m_bindValueAlias(bindValueAliasMap)
+    , m_statement(statement)
    { }
 
+   template<typename... Ts, int... Indexes>
+   std::tuple<Ts...> getTuple(IndexSequence<Indexes...>) const
+   {
+      return std::tuple<Ts...>(ValueConverter<Ts>::convert(m_query.value(Indexes))...);
+   }
+
+   template<typename Tuple, int... Indexes>
+   void fetchTuple(Tuple &tuple, IndexSequence<Indexes...>) const
+   {
+      const int unused[] = { 0, (assignValue(std::get<Indexes>(tuple), Indexes), 0)... };
+      Q_UNUSED(unused);
+   }
+
+   template<typename T, typename... Ms, int... Indexes>
+   void fetchMembers(T &object, IndexSequence<Indexes...>, Ms T::*... members) const
+   {
+      const int unused[] = { 0, (assignValue(object.*members, Indexes), 0)... };
+      Q_UNUSED(unused);
+   }
+
+   template<typename V>
+   void assignValue(V &value, int column) const
+   {
+      value = ValueConverter<V>::convert(m_query.value(column));
+   }
+
+   struct PropertyColumn
+   {
+      QMetaProperty property;
+      int column;
+   };
+
+   typedef QVector<PropertyColumn> FetchPlan;
+
+   /*!
+   \brief Returns writable properties of metaobject mapped on the result columns with the same (case sensitive) names.
+   The plan is computed on the first call for the result set and metaobject.
+   */
+   const FetchPlan &fetchPlan(const QMetaObject *metaobject) const
+   {
+      auto it = m_fetchPlans.find(metaobject);
+
+      if (it != m_fetchPlans.end())
+         return it.value();
+
+      const QSqlRecord record = m_query.record();
+
+      //the last column of duplicated names wins, as with toMap()
+      QHash<QString, int> columns;
+
+      for (int i = 0; i < record.count(); ++i)
+      {
+         columns.insert(record.fieldName(i), i);
+      }
+
+      FetchPlan plan;
+
+      for (int i = 0; i < metaobject->propertyCount(); ++i)
+      {
+         const QMetaProperty metaproperty = metaobject->property(i);
+
+         if (!metaproperty.isWritable())
+            continue;
+
+         const int column = columns.value(QLatin1String(metaproperty.name()), -1);
+
+         if (column >= 0)
+         {
+            PropertyColumn item;
+            item.property = metaproperty;
+            item.column = column;
+
+            plan.append(item);
+         }
+      }
+
+      return m_fetchPlans.insert(metaobject, plan).value();
+   }
+
+   int columnIndex(const QString &colName) const
+   {
+      if (m_columnIndex.isEmpty())
+      {
+         //the record is available before the first row is fetched
+         const QSqlRecord record = m_query.record();
+
+         m_columnIndex.reserve(record.count() * 2);
+
+         for (int i = 0; i < record.count(); ++i)
+         {
+            const QString name = record.fieldName(i);
+
+            //the first column of duplicated names wins, as in QSqlRecord::indexOf
+            if (!m_columnIndex.contains(name))
+               m_columnIndex.insert(name, i);
+
+            const QString lowerName = name.toLower();
+
+            if (!m_columnIndex.contains(lowerName))
+               m_columnIndex.insert(lowerName, i);
+         }
+
+         if (m_columnIndex.isEmpty())
+            return -1;
+      }
+
+      const auto it = m_columnIndex.constFind(colName);
+
+      if (it != m_columnIndex.constEnd())
+         return it.value();
+
+      //other spelling of the name: resolve it once with the record rules and remember the result (or miss)
+      const int index = m_query.record().indexOf(colName);
+
+      m_columnIndex.insert(colName, index);
+
+      return index;
+   }
+
 private:
    QSqlQuery   m_query;
    QStringList m_fieldNames;
-   QMap<QString, int> m_bindValueAlias;
+   mutable QHash<QString, int> m_columnIndex; //column name (as is, lowercased and other resolved spellings) to index
+   mutable QHash<const QMetaObject *, FetchPlan> m_fetchPlans; //fetchGadget/fetchObject mapping plans of the result set
+   QHash<QString, int> m_bindValueAlias;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
+   QSharedPointer<QAtomicInt> m_replicaLease; //outstanding request of the replica the query runs on (see SqlFactory::readDatabase)
+   QSharedPointer<QAtomicInt> m_connectionLease; //see SqlFactory::leaseConnection
+   QVector<QVariant> m_rowValues;  //RowView::values buffer
+   QStringList m_rowStrings;       //RowView::strings buffer
    mutable int m_fetchIndex = 0;
    bool m_firstRowFetched = false;
 };
@@ -0,0 +1,425 @@
+#ifndef EASYQTSQL_SQLDIALECT_H
+#define EASYQTSQL_SQLDIALECT_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+
+#endif
+
+/*!
+\brief SQL syntax specifics of the database behind a connection.
+
+The dialect is detected with QSqlDriver::dbmsType(), so it works for ODBC connections too.
+
+\code
+SqlDialect dialect(db);
+
+//SELECT a FROM table ORDER BY a
+//LIMIT 10 OFFSET 20
+const QString sql = dialect.limitQuery("SELECT a FROM table ORDER BY a", 10, 20);
+\endcode
+*/
+class SqlDialect
+{
+public:
+   enum Type
+   {
+      Unknown,
+      SQLite,
+      MySql,       //!< MySQL and MariaDB
+      PostgreSql,
+      SqlServer,   //!< Microsoft SQL Server 2012+
+      Oracle,      //!< Oracle 12c+
+      Db2,         //!< IBM DB2 11.1+
+      Interbase    //!< Interbase and Firebird
+   };
+
+   explicit SqlDialect(Type type = Unknown)
+      : m_type(type)
+   { }
+
+   explicit SqlDialect(const QSqlDatabase &db)
+      : m_type(Unknown)
+   {
+      const QSqlDriver *driver = db.driver();
+
+      if (!driver)
+         return;
+
+      switch (driver->dbmsType())
+      {
+      case QSqlDriver::SQLite:
+         m_type = SQLite;
+         break;
+      case QSqlDriver::MySqlServer:
+         m_type = MySql;
+         break;
+      case QSqlDriver::PostgreSQL:
+         m_type = PostgreSql;
+         break;
+      case QSqlDriver::MSSqlServer:
+         m_type = SqlServer;
+         break;
+      case QSqlDriver::Oracle:
+         m_type = Oracle;
+         break;
+      case QSqlDriver::DB2:
+         m_type = Db2;
+         break;
+      case QSqlDriver::Interbase:
+         m_type = Interbase;
+         break;
+      default:
+         break;
+      }
+   }
+
+   /*!
+   \brief Returns the dialect type
+   */
+   Type type() const
+   {
+      return m_type;
+   }
+
+   /*!
+   \brief Returns sql limited to count rows starting from row offset with the dialect LIMIT/OFFSET (OFFSET/FETCH, ROWS) clause.
+
+   The clause is appended to sql. Null QString is returned if sql can not be limited safely:
+   the dialect is unknown, sql is not a single SELECT statement (a WITH list followed by SELECT is accepted),
+   sql already has a top-level limiting clause or a top-level FOR clause (FOR UPDATE, FOR SHARE, FOR XML, etc. must stay the last one),
+   SQL Server query has no top-level ORDER BY (required by OFFSET/FETCH).
+   Callers skip the rows on the client side in this case.
+   */
+   QString limitQuery(const QString &sql, int count, int offset = 0) const
+   {
+      Q_ASSERT(count >= 0);
+      Q_ASSERT(offset >= 0);
+
+      if (m_type == Unknown)
+         return QString();
+
+      const Statement statement = analyze(sql);
+
+      if (!statement.isSelect || statement.hasLimit || statement.hasFor)
+         return QString();
+
+      const QString body = sql.left(statement.end);
+
+      switch (m_type)
+      {
+      case SQLite:
+      case MySql:
+      case PostgreSql:
+         return offset > 0
+               ? QString("%0\nLIMIT %1 OFFSET %2").arg(body).arg(count).arg(offset)
+               : QString("%0\nLIMIT %1").arg(body).arg(count);
+
+      case SqlServer:
+         if (!statement.hasOrderBy)
+            return QString();
+
+         return QString("%0\nOFFSET %1 ROWS FETCH NEXT %2 ROWS ONLY").arg(body).arg(offset).arg(count);
+
+      case Oracle:
+      case Db2:
+         return QString("%0\nOFFSET %1 ROWS FETCH NEXT %2 ROWS ONLY").arg(body).arg(offset).arg(count);
+
+      case Interbase:
+         if (count == 0)
+            return QString();
+
+         return QString("%0\nROWS %1 TO %2").arg(body).arg(offset + 1).arg(qint64(offset) + count);
+
+      default:
+         return QString();
+      }
+   }
+
+   /*!
+   \brief Returns true if sql is a single statement which neither modifies data nor takes row locks.
+
+   Accepted statements: SELECT (also after a WITH list) without top-level FOR (FOR UPDATE, FOR SHARE, etc.) and INTO clauses,
+   VALUES, TABLE, SHOW and EXPLAIN without ANALYZE. Literals, quoted identifiers and comments are skipped.
+   \note Functions called by a SELECT statement may still write, such statements are reported as read-only.
+   */
+   static bool isReadOnly(const QString &sql)
+   {
+      const Statement statement = analyze(sql);
+
+      if (statement.isSelect)
+         return !statement.hasFor && !statement.hasInto;
+
+      if (statement.verb == QLatin1String("EXPLAIN"))
+         return !statement.hasAnalyze;
+
+      return statement.verb == QLatin1String("VALUES")
+            || statement.verb == QLatin1String("TABLE")
+            || statement.verb == QLatin1String("SHOW");
+   }
+
+   /*!
+   \brief Returns true if the dialect supports row value comparisons like <em>(a, b) > (?, ?)</em>
+   */
+   bool hasRowValues() const
+   {
+      return m_type == SQLite || m_type == MySql || m_type == PostgreSql;
+   }
+
+   /*!
+   \brief Returns max count of bound parameters of a single statement
+
+   SQLite limit is SQLITE_MAX_VARIABLE_NUMBER: 999 for SQLite builds before 3.32 (32766 since), the lower value is returned.
+   999 is returned for unknown dialects as well.
+   */
+   int maxBoundParameters() const
+   {
+      switch (m_type)
+      {
+      case MySql:
+      case PostgreSql:
+      case Oracle:
+         return 65535;
+      case SqlServer:
+         return 2099; //2100 including the statement itself
+      case Db2:
+      case Interbase:
+         return 32767;
+      default:
+         return 999;
+      }
+   }
+
+   /*!
+   \brief Returns max count of rows of a single multi-row <em>INSERT ... VALUES (...), (...)</em> statement with columnCount parameters per row
+
+   The count is limited by SqlDialect::maxBoundParameters() and by the max count of rows of a VALUES list (1000 for SQL Server).
+   Returns 1 if the dialect does not support multi-row VALUES (Oracle, Interbase, unknown dialect).
+   */
+   int maxValuesRows(int columnCount) const
+   {
+      if (m_type == Unknown || m_type == Oracle || m_type == Interbase)
+         return 1;
+
+      int rows = maxBoundParameters() / qMax(1, columnCount);
+
+      if (m_type == SqlServer)
+         rows = qMin(rows, 1000);
+
+      return qMax(1, rows);
+   }
+
+private:
+   struct Statement
+   {
+      Statement()
+         : isSelect(false)
+         , hasLimit(false)
+         , hasOrderBy(false)
+         , hasFor(false)
+         , hasInto(false)
+         , hasAnalyze(false)
+         , end(0)
+      { }
+
+      QString verb;    //first top-level keyword of a single statement after the WITH list, empty for invalid or multiple statements
+      bool isSelect;   //single SELECT statement
+      bool hasLimit;   //top-level LIMIT, OFFSET, FETCH, TOP or ROWS clause
+      bool hasOrderBy; //top-level ORDER BY
+      bool hasFor;     //top-level FOR clause (FOR UPDATE, FOR SHARE, FOR XML, etc.)
+      bool hasInto;    //top-level INTO clause (SELECT INTO)
+      bool hasAnalyze; //EXPLAIN ANALYZE or EXPLAIN (ANALYZE) which executes the statement
+      int end;         //statement length without trailing ';' and spaces
+   };
+
+   //scans top-level keywords of sql skipping literals, quoted identifiers, comments and parenthesized subqueries
+   static Statement analyze(const QString &sql)
+   {
+      Statement statement;
+
+      const int length = sql.length();
+
+      int depth = 0;
+      int end = 0;
+      bool terminated = false; //';' found
+      bool inWith = false;     //inside the WITH list
+      bool expectName = false; //the next top-level word of the WITH list is a CTE name
+      QString verb;
+      QString prevWord;
+
+      for (int i = 0; i < length; ++i)
+      {
+         const QChar c = sql.at(i);
+
+         if (c.isSpace())
+            continue;
+
+         if (terminated)
+            return Statement(); //more than one statement
+
+         if (c == QLatin1Char('\'') || c == QLatin1Char('"') || c == QLatin1Char('`') || c == QLatin1Char('['))
+         {
+            const QChar close = c == QLatin1Char('[') ? QLatin1Char(']') : c;
+
+            i = sql.indexOf(close, i + 1); //doubled quotes are two adjacent literals here
+
+            if (i < 0)
+               return Statement();
+
+            if (depth == 0 && inWith)
+               expectName = false; //quoted CTE name
+
+            end = i + 1;
+            continue;
+         }
+
+         if (c == QLatin1Char('-') && i + 1 < length && sql.at(i + 1) == QLatin1Char('-'))
+         {
+            i = sql.indexOf(QLatin1Char('\n'), i);
+
+            if (i < 0)
+               break;
+
+            continue;
+         }
+
+         if (c == QLatin1Char('/') && i + 1 < length && sql.at(i + 1) == QLatin1Char('*'))
+         {
+            i = sql.indexOf(QLatin1String("*/"), i + 2);
+
+            if (i < 0)
+               return Statement();
+
+            ++i;
+            continue;
+         }
+
+         if (c == QLatin1Char(';'))
+         {
+            if (depth != 0)
+               return Statement();
+
+            terminated = true;
+            continue;
+         }
+
+         if (c == QLatin1Char(',') && depth == 0 && inWith)
+         {
+            expectName = true; //next CTE
+         }
+         else if (c == QLatin1Char('('))
+         {
+            ++depth;
+         }
+         else if (c == QLatin1Char(')'))
+         {
+            --depth;
+         }
+         else if (c.isLetter() || c == QLatin1Char('_'))
+         {
+            int wordEnd = i + 1;
+
+            while (wordEnd < length && (sql.at(wordEnd).isLetterOrNumber() || sql.at(wordEnd) == QLatin1Char('_')))
+            {
+               ++wordEnd;
+            }
+
+            if (depth == 1 && verb == QLatin1String("EXPLAIN") && sql.mid(i, wordEnd - i).toUpper() == QLatin1String("ANALYZE"))
+            {
+               statement.hasAnalyze = true; //EXPLAIN (ANALYZE, ...) option list
+            }
+            else if (depth == 0)
+            {
+               const QString word = sql.mid(i, wordEnd - i).toUpper();
+
+               if (verb.isEmpty() && !inWith)
+               {
+                  inWith = expectName = word == QLatin1String("WITH");
+
+                  if (!inWith)
+                     verb = word;
+               }
+               else if (inWith)
+               {
+                  //WITH [RECURSIVE] name [(columns)] AS [NOT] [MATERIALIZED] (query), ... verb
+                  if (expectName && word != QLatin1String("RECURSIVE"))
+                  {
+                     expectName = false;
+                  }
+                  else if (!expectName && word != QLatin1String("AS") && word != QLatin1String("NOT") && word != QLatin1String("MATERIALIZED"))
+                  {
+                     inWith = false;
+                     verb = word;
+                  }
+               }
+               else if (word == QLatin1String("FOR"))
+               {
+                  statement.hasFor = true;
+               }
+               else if (word == QLatin1String("INTO"))
+               {
+                  statement.hasInto = true;
+               }
+               else if (word == QLatin1String("ANALYZE"))
+               {
+                  statement.hasAnalyze = true;
+               }
+               else if (word == QLatin1String("LIMIT") || word == QLatin1String("OFFSET") || word == QLatin1String("FETCH")
+                   || word == QLatin1String("TOP") || word == QLatin1String("ROWS"))
+               {
+                  statement.hasLimit = true;
+               }
+               else if (word == QLatin1String("BY") && prevWord == QLatin1String("ORDER"))
+               {
+                  statement.hasOrderBy = true;
+               }
+
+               prevWord = word;
+            }
+
+            i = wordEnd - 1;
+         }
+
+         end = i + 1;
+      }
+
+      if (depth != 0)
+         return Statement();
+
+      statement.verb = verb;
+      statement.isSelect = verb == QLatin1String("SELECT");
+      statement.end = end;
+
+      return statement;
+   }
+
+   Type m_type;
+};
+
+#endif // EASYQTSQL_SQLDIALECT_H
@@ -29,6 +29,9 @@
 #ifndef EASY_QT_SQL_MAIN
 
 #include <QtSql>
+#include "EasyQtSql_DBException.h"
+#include "EasyQtSql_StatementCache.h"
+#include "EasyQtSql_Metrics.h"
 
 #endif
 
@@ -43,10 +46,22 @@ public:
    }
 
    class ThreadDBPool;
+   class ConnectionPool;
+
+   /*!
+   \brief Recursive mutex type of serialized writes (see DBSetting::setSerializedWrites)
+   */
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+   typedef QRecursiveMutex WriteMutex;
+#else
+   typedef QMutex WriteMutex;
+#endif
 
    struct DBSetting
    {
       friend class ThreadDBPool;
+      friend class ConnectionPool;
+      friend class SqlFactory;
 
       DBSetting()
       { }
@@ -64,11 +79,236 @@ public:
          return DBSetting("QSQLITE", ":memory:");
       }
 
+      /*!
+      \brief In-memory SQLite database shared by all the connections (and threads) using the same name.
+
+      The database is opened with a shared cache URI (<em>file:name?mode=memory&cache=shared</em>).
+      SqlFactory::config keeps an extra connection open (DBSetting::setKeepAliveConnection), so the database lives until the setting is replaced.
+
+      The setting runs in single-writer / multi-reader mode:
+       - readers use <em>PRAGMA read_uncommitted</em>, so they never wait for table locks of the writer
+       - writes (Transaction, Database::execNonQuery, PreparedQuery and INSERT / UPDATE / DELETE builders) are serialized (DBSetting::setSerializedWrites)
+
+      \warning Readers may see uncommitted data of the writer. Create the schema before the readers start: schema changes still lock readers out.
+      \param name Name of the shared database
+      */
+      static DBSetting sqliteSharedInmemory(const QString &name)
+      {
+         return DBSetting("QSQLITE", QString("file:%1?mode=memory&cache=shared").arg(name))
+               .setConnectOptions("QSQLITE_OPEN_URI;QSQLITE_BUSY_TIMEOUT=5000")
+               .addInitStatement("PRAGMA read_uncommitted=1")
+               .setSerializedWrites(true)
+               .setKeepAliveConnection(true);
+      }
+
+      /*!
+      \brief SQLite setting tuned for throughput: WAL journal, NORMAL synchronous mode, 64 MB page cache, 256 MB memory map, in-memory temp store and 5 s busy timeout.
+      \param fileName SQLite database file
+      */
+      static DBSetting sqliteHighThroughput(const QString &fileName)
+      {
+         return DBSetting("QSQLITE", fileName)
+               .setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000")
+               .addInitStatement("PRAGMA journal_mode=WAL")
+               .addInitStatement("PRAGMA synchronous=NORMAL")
+               .addInitStatement("PRAGMA cache_size=-65536")
+               .addInitStatement("PRAGMA mmap_size=268435456")
+               .addInitStatement("PRAGMA temp_store=MEMORY");
+      }
+
       QString getType() const
       {
          return type.isEmpty() ? "QODBC" : type;
       }
 
+      /*!
+      \brief Sets driver specific connect options (QSqlDatabase::setConnectOptions) of the connections
+      */
+      DBSetting &setConnectOptions(const QString &options)
+      {
+         connectOptions = options;
+
+         return *this;
+      }
+
+      /*!
+      \brief Adds SQL statement executed once right after each connection is opened (PRAGMA, SET, etc.)
+      */
+      DBSetting &addInitStatement(const QString &statement)
+      {
+         initStatements.append(statement);
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets list of SQL statements executed once right after each connection is opened
+      */
+      DBSetting &setInitStatements(const QStringList &statements)
+      {
+         initStatements = statements;
+
+         return *this;
+      }
+
+      /*!
+      \brief Serializes writes of all the connections created with the setting (and its copies) with a process-wide mutex.
+      \sa WriteLock
+      */
+      DBSetting &setSerializedWrites(bool enabled)
+      {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+         writeMutex = enabled ? QSharedPointer<WriteMutex>(new WriteMutex()) : QSharedPointer<WriteMutex>();
+#else
+         writeMutex = enabled ? QSharedPointer<WriteMutex>(new WriteMutex(QMutex::Recursive)) : QSharedPointer<WriteMutex>();
+#endif
+
+         return *this;
+      }
+
+      /*!
+      \brief SqlFactory::config keeps one more connection open until the setting is replaced (in-memory shared databases live while a connection is open)
+      */
+      DBSetting &setKeepAliveConnection(bool enabled)
+      {
+         keepAliveConnection = enabled;
+
+         return *this;
+      }
+
+      /*!
+      \brief Enables pool mode: connections are shared between threads and checked out with SqlFactory::acquire()
+
+      \warning Qt supports using a QSqlDatabase only from the thread which created it. A pooled connection is opened by one thread and
+      checked out by others, so use pool mode only with drivers known to work across threads (see SqlFactory::isCrossThreadDriver:
+      QPSQL, QMYSQL / QMARIADB). QSQLITE, QODBC and other drivers are not guaranteed to work: use thread-local connections
+      (SqlFactory::getDatabase) with them, or make sure a connection is used by one thread at a time and only with a thread-safe client library.
+      \param minSize Count of idle connections which are never evicted
+      \param maxSize Maximum count of simultaneously open connections. Pool mode is disabled if maxSize <= 0
+      \sa SqlFactory::acquire
+      */
+      DBSetting &setPoolSize(int minSize, int maxSize)
+      {
+         poolMinSize = qMax(0, minSize);
+         poolMaxSize = qMax(0, maxSize);
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets the time (ms) SqlFactory::acquire() waits for a free connection when the pool is exhausted. Negative value means wait forever.
+      */
+      DBSetting &setPoolWaitTimeout(int msec)
+      {
+         poolWaitTimeout = msec;
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets the time (ms) after which an idle pooled connection is closed. Negative value disables idle eviction.
+      */
+      DBSetting &setPoolMaxIdleTime(int msec)
+      {
+         poolMaxIdleTime = msec;
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets max count of cached prepared statements per thread-local connection. Zero capacity disables the statement cache.
+      \sa StatementCache
+      */
+      DBSetting &setStatementCacheCapacity(int capacity)
+      {
+         statementCacheCapacity = qMax(0, capacity);
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets how often (ms) a connection is validated with the validation query before it is handed out.
+
+      Validation runs in SqlFactory::getDatabase and on pool checkout when the last successful validation is older than msec.
+      Zero value validates on every call, negative value disables validation (only QSqlDatabase::isOpen is checked).
+      \sa setValidationQuery
+      */
+      DBSetting &setValidationInterval(int msec)
+      {
+         validationInterval = msec;
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets cheap statement used to check the connection is alive ("SELECT 1" by default)
+      */
+      DBSetting &setValidationQuery(const QString &query)
+      {
+         validationQuery = query;
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets max lifetime (ms) of a pooled connection. Older connections are closed when they are returned to the pool or checked out. Negative value disables the limit.
+      */
+      DBSetting &setMaxLifetime(int msec)
+      {
+         maxLifetime = msec;
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets max count of checkouts of a pooled connection, the connection is closed after the last one. Zero value disables the limit.
+      */
+      DBSetting &setMaxUses(int uses)
+      {
+         maxUses = qMax(0, uses);
+
+         return *this;
+      }
+
+      /*!
+      \brief Sets reconnect policy: a failed open is retried up to maxAttempts times (including the first one), the delay between attempts doubles from initialDelay up to maxDelay ms.
+      */
+      DBSetting &setReconnectBackoff(int initialDelay, int maxDelay, int maxAttempts)
+      {
+         reconnectInitialDelay = qMax(0, initialDelay);
+         reconnectMaxDelay     = qMax(reconnectInitialDelay, maxDelay);
+         reconnectAttempts     = qMax(1, maxAttempts);
+
+         return *this;
+      }
+
+      /*!
+      \brief Enables eager warm-up: SqlFactory::config() preloads the driver plugin and opens connections before the first request.
+
+      In pool mode the connections are opened into the pool (up to the max pool size), see the thread affinity warning of setPoolSize.
+      In thread-local mode the opened connections are handed over to the first threads calling SqlFactory::getDatabase.
+      It happens only for drivers which work across threads (SqlFactory::isCrossThreadDriver), other drivers get the driver plugin preloaded only.
+      \param connections Count of connections to open. Zero value preloads the driver plugin only
+      \param background Warm up in QThreadPool::globalInstance() thread, SqlFactory::config() does not wait for it.
+      The connections are opened by the thread pool thread and used by other threads (see SqlFactory::isCrossThreadDriver)
+      */
+      DBSetting &setWarmup(int connections, bool background = false)
+      {
+         warmup = true;
+         warmupConnections  = qMax(0, connections);
+         warmupInBackground = background;
+
+         return *this;
+      }
+
+      /*!
+      \brief Returns true if pool mode is enabled for the setting
+      */
+      bool isPooled() const
+      {
+         return poolMaxSize > 0;
+      }
+
    private:
       QString  type;
       QVariant port;
@@ -76,128 +316,1780 @@ public:
       QString  username;
       QString  password;
       QString  dbName;
+
+      QString     connectOptions;
+      QStringList initStatements;
+
+      int poolMinSize     = 0;
+      int poolMaxSize     = 0;
+      int poolWaitTimeout = 30000;
+      int poolMaxIdleTime = 600000;
+
+      int statementCacheCapacity = 32;
+
+      bool warmup             = false;
+      int  warmupConnections  = 0;
+      bool warmupInBackground = false;
+
+      int     validationInterval = -1;
+      QString validationQuery    = "SELECT 1";
+      int     maxLifetime        = -1;
+      int     maxUses            = 0;
+
+      int reconnectInitialDelay = 100;
+      int reconnectMaxDelay     = 5000;
+      int reconnectAttempts     = 1;
+
+      QSharedPointer<WriteMutex> writeMutex; //shared by the copies of the setting
+      bool keepAliveConnection = false;
    };
 
-   class ThreadDBPool
+   /*!
+   \brief Locks the write mutex of db for the lifetime of the object if db is configured with DBSetting::setSerializedWrites. Does nothing otherwise.
+
+   Taken by Transaction (for the whole transaction), Database::execNonQuery, PreparedQuery and INSERT / UPDATE / DELETE builders.
+   The mutex is recursive: writes inside a transaction of the same thread do not block.
+   */
+   class WriteLock
    {
+      Q_DISABLE_COPY(WriteLock)
+
    public:
+      explicit WriteLock(const QSqlDatabase &db)
+         : WriteLock(db.driver())
+      { }
 
-      ~ThreadDBPool()
+      explicit WriteLock(const QSqlDriver *driver)
+         : m_mutex(writeMutex(driver))
       {
-         for (const QString &uniqueConnName : m_connNameMap.values())
+         if (m_mutex)
          {
-            {
-               QSqlDatabase db = QSqlDatabase::database(uniqueConnName);
-               if (db.isOpen())
-               {
-                  db.close();
-               }
-            }
+            m_mutex->lock();
+         }
+      }
 
-            QSqlDatabase::removeDatabase(uniqueConnName);
+      ~WriteLock()
+      {
+         unlock();
+      }
+
+      void unlock()
+      {
+         if (m_mutex)
+         {
+            m_mutex->unlock();
+            m_mutex = nullptr;
          }
       }
 
-      void addConnection(const DBSetting &settings, const QString &connectionName)
+   private:
+      WriteMutex *m_mutex;
+   };
+
+   /*!
+   \brief Lifetime, usage and validation state of a connection
+   */
+   struct ConnectionHealth
+   {
+      ConnectionHealth()
       {
-         const QString uniqueConnectionName = connectionName + QUuid::createUuid().toString();
+         opened.start();
+         validated.start();
+      }
+
+      QElapsedTimer opened;
+      QElapsedTimer validated;
+      int uses = 0;
+   };
+
+   /*!
+   \brief Connections of a single thread, created by SqlFactory::getDatabase.
+
+   The owner thread reads the pool without locking. SqlFactory::reapIdleConnections runs in another thread and never touches the connections:
+   it switches idle, not leased connections to the expired state. An expired connection is closed by the owner thread, by a queued call
+   (if the thread runs an event loop) or by the next SqlFactory::getDatabase call.
+
+   Database, Transaction, QueryResult and PreparedQuery objects lease the connection (see SqlFactory::leaseConnection):
+   a leased connection is never expired or closed.
+   */
+   class ThreadDBPool
+   {
+      Q_DISABLE_COPY(ThreadDBPool)
 
-         m_connNameMap.insert(connectionName, uniqueConnectionName);
+   public:
+      ThreadDBPool()
+      { }
 
-         QSqlDatabase db = QSqlDatabase::addDatabase(settings.getType(), uniqueConnectionName);
+      ~ThreadDBPool()
+      {
+         getInstance()->unregisterThreadPool(this); //the reaper must not see the pool anymore, queued calls die with m_context
 
-         db.setDatabaseName(settings.dbName);
-         db.setHostName(settings.host);
-         db.setUserName(settings.username);
-         db.setPassword(settings.password);
+         m_statementCaches.clear(); //cached statements must not outlive their connections
 
-         if (settings.port.isValid())
+         for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
          {
-            db.setPort(settings.port.toInt());
+            closeConnection(it.value()->db);
          }
       }
 
+      /*!
+      \brief Adds connection for connectionName to the pool
+      \param warmConnection Already opened connection to adopt (see DBSetting::setWarmup). New connection is created if it is not valid
+      */
+      void addConnection(const DBSetting &settings, const QString &connectionName, const QSqlDatabase &warmConnection = QSqlDatabase())
+      {
+         const QSqlDatabase db = warmConnection.isValid()
+               ? warmConnection
+               : createConnection(settings, connectionName + QUuid::createUuid().toString());
+
+         QSharedPointer<ThreadConnection> connection(new ThreadConnection());
+         connection->db = db;
+         connection->settings = settings;
+         connection->metrics = getInstance()->connectionMetrics(connectionName);
+         connection->lastUse.store(getInstance()->m_clock.elapsed());
+
+         QMutexLocker locker(&m_mutex); //the reaper iterates the connections
+
+         m_connections.insert(connectionName, connection);
+         m_connectionNames.insert(db.connectionName(), connectionName);
+         m_statementCaches.insert(db.connectionName(), QSharedPointer<StatementCache>(new StatementCache(settings.statementCacheCapacity, connection->metrics)));
+      }
+
       bool connectionExists(const QString &connectionName) const
       {
-         return m_connNameMap.contains(connectionName);
+         return m_connections.contains(connectionName);
       }
 
-      QSqlDatabase getDatabase(const QString &connectionName) const
+      /*!
+      \brief Returns the connection for connectionName. Closed, expired or broken (see DBSetting::setValidationInterval) connection is reopened.
+      */
+      QSqlDatabase getDatabase(const QString &connectionName)
       {
-         const QString &uniqueConnectionName = m_connNameMap.value(connectionName);
+         //the connection object is kept by the pool: no QSqlDatabase::database() lookup (and its global lock) here
+         const QSharedPointer<ThreadConnection> connection = m_connections.value(connectionName);
+
+         if (!connection)
+         {
+            return QSqlDatabase();
+         }
 
-         QSqlDatabase db = QSqlDatabase::database(uniqueConnectionName);
+         if (acquireConnection(*connection) == Expired && connection->leases.load() == 0 && connection->db.isOpen())
+         {
+            connection->db.close(); //reaped: reopened below
+         }
 
-         if (!db.isOpen())
+         if (!validateConnection(connection->db, connection->settings, connection->health))
          {
-            if (!db.open())
+            if (StatementCache *cache = statementCache(connection->db.connectionName()))
             {
-               qCritical() << db.lastError().text();
+               cache->clear(); //statements of the closed connection are not valid anymore
             }
+
+            if (connection->db.isOpen())
+            {
+               connection->db.close();
+            }
+
+            const QSqlError error = reconnect(connection->db, connection->settings, connection->metrics);
+
+            if (error.isValid())
+            {
+               qCritical() << error.text();
+            }
+
+            connection->health = ConnectionHealth();
          }
 
-         return db;
+         connection->lastUse.store(getInstance()->m_clock.elapsed());
+         connection->state.storeRelease(Idle);
+
+         return connection->db;
       }
 
-   private:
-      QMap<QString, QString> m_connNameMap;
-   };
+      /*!
+      \brief Returns lease of the connection with uniqueConnectionName (QSqlDatabase::connectionName), null for foreign connections.
+      The connection is not reaped while a lease copy is alive.
+      */
+      QSharedPointer<QAtomicInt> lease(const QString &uniqueConnectionName) const
+      {
+         const QSharedPointer<ThreadConnection> connection = m_connections.value(m_connectionNames.value(uniqueConnectionName));
 
-   SqlFactory *config(const DBSetting &settings, const QString &connectionName = QSqlDatabase::defaultConnection)
-   {
-      QMutexLocker locker(&mutex);
+         if (!connection)
+         {
+            return QSharedPointer<QAtomicInt>();
+         }
 
-      m_settings.insert(connectionName, settings);
+         connection->leases.ref();
 
-      return this;
-   }
+         //the deleter keeps the connection state alive
+         return QSharedPointer<QAtomicInt>(&connection->leases, [connection](QAtomicInt *leases) { leases->deref(); });
+      }
 
-   QSqlDatabase getDatabase(const QString &connectionName = QSqlDatabase::defaultConnection)
-   {
-      QMutexLocker locker(&mutex);
+      /*!
+      \brief Returns QSqlDatabase::connectionName of the thread-local connection created for connectionName
+      */
+      QString uniqueConnectionName(const QString &connectionName) const
+      {
+         const QSharedPointer<ThreadConnection> connection = m_connections.value(connectionName);
+
+         return connection ? connection->db.connectionName() : QString();
+      }
+
+      /*!
+      \brief Returns the connection name used with SqlFactory::config for the thread-local connection with uniqueConnectionName (empty string for foreign connections)
+      */
+      QString connectionName(const QString &uniqueConnectionName) const
+      {
+         return m_connectionNames.value(uniqueConnectionName);
+      }
+
+      /*!
+      \brief Returns statement cache of the connection with uniqueConnectionName (QSqlDatabase::connectionName)
+      */
+      StatementCache *statementCache(const QString &uniqueConnectionName) const
+      {
+         return m_statementCaches.value(uniqueConnectionName).data();
+      }
 
-      if (m_settings.contains(connectionName))
+      /*!
+      \brief Adds count of not reaped connections of the pool to counts (keyed by connection name). Called from any thread.
+      */
+      void countConnections(QHash<QString, int> &counts) const
       {
-         ThreadDBPool *threadDbPool = nullptr;
+         QMutexLocker locker(&m_mutex);
 
-         if (!m_dbPool.hasLocalData())
+         for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it)
          {
-            threadDbPool = new ThreadDBPool(); //new pool for current thread
+            if (it.value()->state.load() != Closed)
+            {
+               ++counts[it.key()];
+            }
+         }
+      }
 
-            m_dbPool.setLocalData(threadDbPool);
+      /*!
+      \brief Expires connections not leased and not requested with getDatabase for longer than maxIdleTime ms. Called from any thread.
+
+      The expired connections are closed by the owner thread (see ThreadDBPool).
+      \return Count of expired connections
+      */
+      int reapIdle(qint64 now, qint64 maxIdleTime)
+      {
+         QMutexLocker locker(&m_mutex);
+
+         int expired = 0;
+
+         for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
+         {
+            ThreadConnection &connection = *it.value();
+
+            if (now - connection.lastUse.load() > maxIdleTime
+                && connection.leases.load() == 0
+                && connection.state.testAndSetOrdered(Idle, Expired))
+            {
+               ++expired;
+            }
          }
-         else
+
+         if (expired > 0)
+         {
+            QMetaObject::invokeMethod(&m_context, [this]() { closeExpired(); }, Qt::QueuedConnection);
+         }
+
+         return expired;
+      }
+
+   private:
+      enum ConnectionState
+      {
+         Idle,    //open or closed by the owner, may be expired by the reaper
+         Busy,    //prepared by the owner thread in getDatabase
+         Expired, //expired by the reaper, closed by the owner thread if it is not leased
+         Closed   //closed after expiration, the next getDatabase call reopens it
+      };
+
+      struct ThreadConnection
+      {
+         QSqlDatabase       db;
+         DBSetting          settings;
+         ConnectionHealth   health;
+         ConnectionMetrics *metrics = nullptr;
+
+         QAtomicInt              state;   //ConnectionState
+         QAtomicInt              leases;  //alive Database, QueryResult and PreparedQuery objects of the owner thread
+         QAtomicInteger<qint64>  lastUse; //SqlFactory clock, ms
+      };
+
+      /*!
+      \brief Switches the connection to the busy state
+      \return Previous state of the connection
+      */
+      static int acquireConnection(ThreadConnection &connection)
+      {
+         for (;;)
          {
-            threadDbPool = m_dbPool.localData();
+            const int state = connection.state.loadAcquire();
+
+            if (connection.state.testAndSetAcquire(state, Busy)) //the reaper may expire an idle connection meanwhile
+               return state;
          }
+      }
 
-         if (threadDbPool)
+      /*!
+      \brief Closes expired connections which are not leased. Queued to the owner thread by reapIdle.
+      */
+      void closeExpired()
+      {
+         for (auto it = m_connections.begin(); it != m_connections.end(); ++it)
          {
-            if (!threadDbPool->connectionExists(connectionName)) //if no connection created for current thread
+            ThreadConnection &connection = *it.value();
+
+            if (connection.leases.load() > 0 || !connection.state.testAndSetAcquire(Expired, Busy))
+            {
+               continue;
+            }
+
+            if (StatementCache *cache = statementCache(connection.db.connectionName()))
             {
-               const DBSetting &settings = m_settings[connectionName];
+               cache->clear(); //statements of the closed connection are not valid anymore
+            }
 
-               threadDbPool->addConnection(settings, connectionName); //create new connection with specified settings for current thread
+            if (connection.db.isOpen())
+            {
+               connection.db.close();
             }
 
-            return threadDbPool->getDatabase(connectionName);
+            connection.state.storeRelease(Closed);
          }
       }
 
-      return QSqlDatabase();
-   }
+      QObject m_context; //lives in the owner thread, receives queued closeExpired calls
 
-private:
-   QMutex mutex;
+      mutable QMutex m_mutex; //guards m_connections against the reaper, the owner thread reads it without locking
 
-   QMap<QString, DBSetting> m_settings;
-   QThreadStorage<ThreadDBPool*> m_dbPool;
+      QHash<QString, QSharedPointer<ThreadConnection>> m_connections;
+      QHash<QString, QString> m_connectionNames; //QSqlDatabase::connectionName -> SqlFactory connection name
+      QHash<QString, QSharedPointer<StatementCache>> m_statementCaches;
+   };
 
-   QString m_defaultConnName;
+   /*!
+   \brief Bounded set of connections shared between threads.
 
-private:
-   SqlFactory()
-   {}
+   Created by SqlFactory::config() for settings with pool mode enabled (DBSetting::setPoolSize).
+   Connections are checked out with SqlFactory::acquire() and returned to the pool when the PooledConnection handle is destroyed.
+
+   \warning A connection is opened by one thread and used by the others: see the thread affinity warning of DBSetting::setPoolSize.
+   */
+   class ConnectionPool
+   {
+      Q_DISABLE_COPY(ConnectionPool)
+
+   public:
+      ConnectionPool(const DBSetting &settings, const QString &connectionName)
+         : m_settings(settings)
+         , m_connectionName(connectionName)
+         , m_metrics(getInstance()->connectionMetrics(connectionName))
+      { }
+
+      ~ConnectionPool()
+      {
+         QMutexLocker locker(&m_mutex);
+
+         while (!m_idle.isEmpty())
+         {
+            QSqlDatabase db = m_idle.takeLast().db;
+
+            closeConnection(db);
+         }
+      }
+
+      /*!
+      \brief Takes an idle connection or opens a new one if the pool is not full. Waits up to waitTimeout ms for a returned connection otherwise.
+
+      Idle connections exceeding DBSetting::setMaxLifetime / DBSetting::setMaxUses limits or failing validation (DBSetting::setValidationInterval) are closed and skipped.
+      \param waitTimeout Wait timeout (ms), negative value means wait forever
+      \param[out] error Error description if no connection could be checked out
+      \return Open connection or invalid QSqlDatabase on timeout / open failure
+      */
+      QSqlDatabase checkout(int waitTimeout, QSqlError *error = nullptr)
+      {
+         QMutexLocker locker(&m_mutex);
+
+         QElapsedTimer waitTimer;
+         waitTimer.start();
+
+         for (;;)
+         {
+            evictIdleLocked();
+
+            if (!m_idle.isEmpty())
+            {
+               QSqlDatabase db = m_idle.takeLast().db; //most recently used connection first
+
+               ConnectionHealth health = m_health.value(db.connectionName());
+
+               locker.unlock();
+
+               //the validation query runs without the lock
+               const bool usable = !isExpired(health, m_settings) && validateConnection(db, m_settings, health);
+
+               locker.relock();
+
+               if (usable)
+               {
+                  ++health.uses;
+
+                  m_health.insert(db.connectionName(), health);
+
+                  recordCheckout(waitTimer);
+
+                  return db;
+               }
+
+               dropLocked(db);
+
+               continue;
+            }
+
+            if (m_openCount < m_settings.poolMaxSize)
+            {
+               ++m_openCount;
+
+               locker.unlock();
+
+               QSqlDatabase db = createConnection(m_settings, m_connectionName + QUuid::createUuid().toString());
+
+               const QSqlError openError = reconnect(db, m_settings, m_metrics);
+
+               locker.relock();
+
+               if (!openError.isValid())
+               {
+                  ConnectionHealth health;
+                  health.uses = 1;
+
+                  m_health.insert(db.connectionName(), health);
+
+                  recordCheckout(waitTimer);
+
+                  return db;
+               }
+
+               qCritical() << openError.text();
+
+               dropLocked(db);
+
+               if (error)
+                  *error = openError;
+
+               return QSqlDatabase();
+            }
+
+            const qint64 remaining = waitTimeout - waitTimer.elapsed();
+
+            if (waitTimeout >= 0 && remaining <= 0)
+            {
+               m_metrics->checkoutTimeouts.fetchAndAddRelaxed(1);
+               m_metrics->checkoutWait.record(waitTimer.nsecsElapsed() / 1000);
+
+               if (error)
+                  *error = QSqlError(QLatin1String("Connection pool exhausted"), m_connectionName, QSqlError::ConnectionError);
+
+               return QSqlDatabase();
+            }
+
+            if (waitTimeout >= 0)
+            {
+               m_available.wait(&m_mutex, static_cast<unsigned long>(remaining));
+            }
+            else
+            {
+               m_available.wait(&m_mutex);
+            }
+         }
+      }
+
+      /*!
+      \brief Returns checked out connection to the pool. Closed connections are dropped.
+
+      The db reference is reset, so the pool keeps the only reference to the connection.
+      */
+      void checkin(QSqlDatabase &db)
+      {
+         QMutexLocker locker(&m_mutex);
+
+         if (db.isOpen() && !isExpired(m_health.value(db.connectionName()), m_settings))
+         {
+            IdleConnection idle;
+            idle.db = db;
+            idle.idleTimer.start();
+
+            m_idle.append(idle);
+
+            db = QSqlDatabase();
+         }
+         else
+         {
+            dropLocked(db);
+         }
+
+         m_available.wakeOne();
+      }
+
+      /*!
+      \brief Opens connections into the pool until count connections are open (bounded by the max pool size)
+      \return Count of opened connections
+      */
+      int warmup(int count)
+      {
+         int opened = 0;
+
+         for (;;)
+         {
+            {
+               QMutexLocker locker(&m_mutex);
+
+               if (m_openCount >= qMin(count, m_settings.poolMaxSize))
+                  break;
+
+               ++m_openCount;
+            }
+
+            QSqlDatabase db = createConnection(m_settings, m_connectionName + QUuid::createUuid().toString());
+
+            const QSqlError openError = reconnect(db, m_settings, m_metrics);
+
+            if (openError.isValid())
+            {
+               qCritical() << openError.text();
+
+               QMutexLocker locker(&m_mutex);
+
+               dropLocked(db);
+
+               break;
+            }
+
+            {
+               QMutexLocker locker(&m_mutex);
+
+               m_health.insert(db.connectionName(), ConnectionHealth());
+            }
+
+            checkin(db);
+
+            ++opened;
+         }
+
+         return opened;
+      }
+
+      /*!
+      \brief Removes an idle connection from the pool without waiting, the caller becomes its owner
+      \return Open connection or invalid QSqlDatabase if there are no idle connections
+      */
+      QSqlDatabase takeIdle()
+      {
+         QMutexLocker locker(&m_mutex);
+
+         if (m_idle.isEmpty())
+         {
+            return QSqlDatabase();
+         }
+
+         --m_openCount;
+         m_available.wakeOne();
+
+         QSqlDatabase db = m_idle.takeLast().db;
+
+         m_health.remove(db.connectionName());
+
+         return db;
+      }
+
+      /*!
+      \brief Closes connections idle longer than the DBSetting::setPoolMaxIdleTime limit (keeps at least DBSetting::setPoolSize minSize connections open).
+      */
+      void evictIdle()
+      {
+         QMutexLocker locker(&m_mutex);
+
+         evictIdleLocked();
+      }
+
+      /*!
+      \brief Returns count of open connections (idle and checked out)
+      */
+      int openCount() const
+      {
+         QMutexLocker locker(&m_mutex);
+
+         return m_openCount;
+      }
+
+      /*!
+      \brief Returns count of idle connections
+      */
+      int idleCount() const
+      {
+         QMutexLocker locker(&m_mutex);
+
+         return m_idle.count();
+      }
+
+      const DBSetting &settings() const
+      {
+         return m_settings;
+      }
+
+   private:
+      struct IdleConnection
+      {
+         QSqlDatabase  db;
+         QElapsedTimer idleTimer;
+      };
+
+      void evictIdleLocked()
+      {
+         //m_idle is ordered by return time, the longest idle connection is the first one
+         while (m_openCount > m_settings.poolMinSize
+                && !m_idle.isEmpty()
+                && m_idle.first().idleTimer.hasExpired(m_settings.poolMaxIdleTime))
+         {
+            QSqlDatabase db = m_idle.takeFirst().db;
+
+            dropLocked(db);
+         }
+      }
+
+      void recordCheckout(const QElapsedTimer &waitTimer)
+      {
+         m_metrics->checkouts.fetchAndAddRelaxed(1);
+         m_metrics->checkoutWait.record(waitTimer.nsecsElapsed() / 1000);
+      }
+
+      /*!
+      \brief Closes a connection which leaves the pool and frees its slot
+      */
+      void dropLocked(QSqlDatabase &db)
+      {
+         m_health.remove(db.connectionName());
+
+         closeConnection(db);
+
+         --m_openCount;
+         m_available.wakeOne();
+      }
+
+      const DBSetting m_settings;
+      const QString   m_connectionName;
+
+      ConnectionMetrics *m_metrics;
+
+      mutable QMutex  m_mutex;
+      QWaitCondition  m_available;
+
+      QList<IdleConnection> m_idle;
+      QHash<QString, ConnectionHealth> m_health; //keyed by QSqlDatabase::connectionName
+      int m_openCount = 0;
+   };
+
+   /*!
+   \brief RAII handle of a connection checked out from ConnectionPool. The connection is returned to the pool on destruction.
+
+   \code
+   SqlFactory::getInstance()->config(SqlFactory::DBSetting("QPSQL", "host", 5432, "user", "password", "db").setPoolSize(2, 16));
+
+   SqlFactory::PooledConnection conn = SqlFactory::getInstance()->acquire();
+
+   Transaction t(conn.database());
+   //...
+   t.commit();
+   \endcode
+
+   \warning Destroy Database / Transaction objects using the connection before the handle.
+   The connection may have been opened by another thread: use the pool mode only with drivers listed in SqlFactory::isCrossThreadDriver.
+   */
+   class PooledConnection
+   {
+      Q_DISABLE_COPY(PooledConnection)
+
+      friend class SqlFactory;
+
+   public:
+      PooledConnection()
+      { }
+
+      PooledConnection(PooledConnection &&other)
+         : m_pool(other.m_pool)
+         , m_db(other.m_db)
+         , m_error(other.m_error)
+      {
+         other.m_pool.clear();
+         other.m_db = QSqlDatabase();
+      }
+
+      PooledConnection &operator=(PooledConnection &&other)
+      {
+         if (this == &other) return *this;
+
+         release();
+
+         m_pool  = other.m_pool;
+         m_db    = other.m_db;
+         m_error = other.m_error;
+
+         other.m_pool.clear();
+         other.m_db = QSqlDatabase();
+
+         return *this;
+      }
+
+      ~PooledConnection()
+      {
+         release();
+      }
+
+      /*!
+      \brief Returns checked out connection (invalid QSqlDatabase if checkout failed)
+      */
+      QSqlDatabase database() const
+      {
+         return m_db;
+      }
+
+      /*!
+      \brief Returns true if the handle holds a connection
+      */
+      bool isValid() const
+      {
+         return m_db.isValid();
+      }
+
+      /*!
+      \brief Returns checkout error (pool exhausted or connection open error)
+      */
+      QSqlError lastError() const
+      {
+         return m_error;
+      }
+
+      /*!
+      \brief Returns the connection to the pool before the handle is destroyed
+      */
+      void release()
+      {
+         QSharedPointer<ConnectionPool> pool = m_pool;
+         QSqlDatabase db = m_db;
+
+         m_pool.clear();
+         m_db = QSqlDatabase();
+
+         if (pool && db.isValid())
+         {
+            pool->checkin(db);
+         }
+      }
+
+   private:
+      PooledConnection(const QSharedPointer<ConnectionPool> &pool, const QSqlDatabase &db, const QSqlError &error)
+         : m_pool(pool)
+         , m_db(db)
+         , m_error(error)
+      { }
+
+      QSharedPointer<ConnectionPool> m_pool;
+      QSqlDatabase m_db;
+      QSqlError    m_error;
+   };
+
+   /*!
+   \brief Sets connection settings for connectionName.
+
+   Settings are published as an immutable snapshot, so SqlFactory::getDatabase reads them without locking.
+   Each thread keeps the snapshot it read last, the replaced snapshots are freed once all the threads moved to the new one.
+   Connections already created by the threads are not affected.
+
+   Connections are warmed up here if DBSetting::setWarmup is set.
+   */
+   SqlFactory *config(const DBSetting &settings, const QString &connectionName = QSqlDatabase::defaultConnection)
+   {
+      QMutexLocker locker(&mutex);
+
+      const QSharedPointer<const Settings> current = m_settings.current();
+
+      Settings *snapshot = current ? new Settings(*current) : new Settings();
+
+      snapshot->insert(connectionName, settings);
+
+      m_settings.store(QSharedPointer<const Settings>(snapshot)); //threads still reading the replaced snapshot keep it alive
+
+      QSharedPointer<ConnectionPool> warmupPool;
+
+      m_pools.remove(connectionName);
+      m_warmConnections.remove(connectionName);
+
+      if (settings.isPooled())
+      {
+         warmupPool = QSharedPointer<ConnectionPool>(new ConnectionPool(settings, connectionName));
+
+         m_pools.insert(connectionName, warmupPool);
+      }
+      else if (settings.warmup && settings.warmupConnections > 0 && isCrossThreadDriver(settings.getType()))
+      {
+         //warm connections wait in a pool of their own until threads adopt them
+         warmupPool = QSharedPointer<ConnectionPool>(new ConnectionPool(DBSetting(settings)
+                                                                       .setPoolSize(0, settings.warmupConnections)
+                                                                       .setPoolMaxIdleTime(-1), connectionName));
+
+         m_warmConnections.insert(connectionName, warmupPool);
+      }
+
+      //the new keep-alive connection is opened before the old one is closed: shared in-memory data survives re-configuration
+      QSqlDatabase retiredKeepAlive = m_keepAliveConnections.take(connectionName);
+
+      if (settings.keepAliveConnection)
+      {
+         QSqlDatabase keepAlive = createConnection(settings, connectionName + QLatin1String("/keepAlive") + QUuid::createUuid().toString());
+
+         const QSqlError error = openConnection(keepAlive, settings);
+
+         if (error.isValid())
+         {
+            qCritical() << error.text();
+         }
+
+         m_keepAliveConnections.insert(connectionName, keepAlive);
+      }
+
+      if (retiredKeepAlive.isValid())
+      {
+         closeConnection(retiredKeepAlive);
+      }
+
+      if (settings.writeMutex)
+      {
+         m_serializedWrites.storeRelease(1);
+      }
+
+      locker.unlock();
+
+      if (settings.warmup)
+      {
+         WarmupTask *warmupTask = new WarmupTask(settings.getType(), warmupPool, settings.warmupConnections);
+
+         if (settings.warmupInBackground)
+         {
+            QThreadPool::globalInstance()->start(warmupTask); //the thread pool deletes the task
+         }
+         else
+         {
+            warmupTask->run();
+
+            delete warmupTask;
+         }
+      }
+
+      return this;
+   }
+
+   /*!
+   \brief Returns true if connections of driverType are known to work when opened in one thread and used in another one (QPSQL, QMYSQL, QMARIADB).
+
+   Qt guarantees QSqlDatabase works only in the thread which created it. Pool mode (DBSetting::setPoolSize) and warm thread-local
+   connections (DBSetting::setWarmup) move connections between threads.
+   */
+   static bool isCrossThreadDriver(const QString &driverType)
+   {
+      return driverType == QLatin1String("QPSQL")
+            || driverType == QLatin1String("QMYSQL")
+            || driverType == QLatin1String("QMARIADB");
+   }
+
+   /*!
+   \brief Returns the connection of the current thread for connectionName, creates and opens it on the first call.
+
+   The method takes no locks once the connection of the current thread exists.
+   */
+   QSqlDatabase getDatabase(const QString &connectionName = QSqlDatabase::defaultConnection)
+   {
+      ThreadDBPool *threadDbPool = m_dbPool.hasLocalData() ? m_dbPool.localData() : nullptr;
+
+      if (threadDbPool && threadDbPool->connectionExists(connectionName)) //fast path: thread-local data only
+      {
+         return threadDbPool->getDatabase(connectionName);
+      }
+
+      const Settings *settings = m_settings.load();
+
+      if (settings && settings->contains(connectionName))
+      {
+         if (!threadDbPool)
+         {
+            threadDbPool = new ThreadDBPool(); //new pool for current thread
+
+            m_dbPool.setLocalData(threadDbPool);
+
+            registerThreadPool(threadDbPool);
+         }
+
+         const DBSetting setting = settings->value(connectionName);
+
+         //create new connection with specified settings for current thread or adopt a warmed up one
+         threadDbPool->addConnection(setting, connectionName, setting.warmup ? takeWarmConnection(connectionName) : QSqlDatabase());
+
+         return threadDbPool->getDatabase(connectionName);
+      }
+
+      return QSqlDatabase();
+   }
+
+   /*!
+   \brief Replica selection policy of SqlFactory::configReplicas
+   */
+   enum ReplicaPolicy
+   {
+      RoundRobin,      //!< Replicas are used in turn
+      LeastOutstanding //!< Replica with the least count of running read queries (and alive QueryResult objects) is used
+   };
+
+   /*!
+   \brief Read-your-writes scope of the current thread.
+
+   Read queries of Database go to replicas (see SqlFactory::configReplicas) until the first write of the thread inside the scope.
+   All the reads after it go to the primary connection until the scope (the outermost one for nested scopes) ends.
+
+   \code
+   {
+      SqlFactory::ReadYourWrites scope;
+
+      Database sdb(SqlFactory::getInstance()->getDatabase());
+
+      sdb.execNonQuery("UPDATE account SET balance = 0 WHERE id = 1");
+
+      sdb.scalar<int>("SELECT balance FROM account WHERE id = 1"); //read from the primary, replicas may lag
+   }
+   \endcode
+   */
+   class ReadYourWrites
+   {
+      Q_DISABLE_COPY(ReadYourWrites)
+
+   public:
+      ReadYourWrites()
+      {
+         ++getInstance()->m_readYourWrites.localData().scopes;
+      }
+
+      ~ReadYourWrites()
+      {
+         StickyState &state = getInstance()->m_readYourWrites.localData();
+
+         if (--state.scopes == 0)
+         {
+            state.wrote = false;
+         }
+      }
+   };
+
+   /*!
+   \brief Sets read replicas of connectionName.
+
+   Each replica gets its own thread-local connection. Read queries of Database (Database::execQuery, Database::scalar, Database::each, etc.)
+   over the thread-local connection of connectionName are routed to the replicas. Database::execNonQuery, Transaction, prepared queries and
+   INSERT / UPDATE / DELETE builders stay on the primary connection.
+   \param replicas Replica settings, empty list disables routing
+   \param connectionName Primary connection name used with SqlFactory::config
+   \param policy Replica selection policy
+   \sa ReadYourWrites, readDatabase
+   */
+   SqlFactory *configReplicas(const QList<DBSetting> &replicas, const QString &connectionName = QSqlDatabase::defaultConnection, ReplicaPolicy policy = RoundRobin)
+   {
+      ReplicaGroup group;
+      group.policy = policy;
+      group.next = QSharedPointer<QAtomicInt>(new QAtomicInt());
+
+      for (int i = 0; i < replicas.count(); ++i)
+      {
+         const QString replicaName = connectionName + QLatin1String("/replica") + QString::number(i);
+
+         config(replicas.at(i), replicaName);
+
+         group.connectionNames.append(replicaName);
+         group.outstanding.append(QSharedPointer<QAtomicInt>(new QAtomicInt()));
+      }
+
+      QMutexLocker locker(&mutex);
+
+      const QSharedPointer<const ReplicaGroups> current = m_replicaGroups.current();
+
+      ReplicaGroups *snapshot = current ? new ReplicaGroups(*current) : new ReplicaGroups();
+
+      if (replicas.isEmpty())
+      {
+         snapshot->remove(connectionName);
+      }
+      else
+      {
+         snapshot->insert(connectionName, group);
+      }
+
+      m_replicaGroups.store(QSharedPointer<const ReplicaGroups>(snapshot)); //threads still reading the replaced snapshot keep it alive
+
+      return this;
+   }
+
+   /*!
+   \brief Returns connection for a read query: a replica connection of the current thread if replicas are configured for the primary
+   (see SqlFactory::configReplicas) and the thread did not write inside ReadYourWrites scope, otherwise primary.
+   \param primary Thread-local connection returned by SqlFactory::getDatabase
+   \param[out] lease Outstanding request lease of the chosen replica (used by ReplicaPolicy::LeastOutstanding), keep it while the query is in use
+   */
+   QSqlDatabase readDatabase(const QSqlDatabase &primary, QSharedPointer<QAtomicInt> *lease = nullptr)
+   {
+      const ReplicaGroups *groups = m_replicaGroups.load();
+
+      ThreadDBPool *threadDbPool = m_dbPool.hasLocalData() ? m_dbPool.localData() : nullptr;
+
+      if (!groups || !threadDbPool)
+      {
+         return primary;
+      }
+
+      const auto it = groups->constFind(threadDbPool->connectionName(primary.connectionName()));
+
+      if (it == groups->constEnd() || m_readYourWrites.localData().wrote)
+      {
+         return primary;
+      }
+
+      const ReplicaGroup &group = it.value();
+
+      const int count = group.connectionNames.count();
+
+      int index = static_cast<int>(static_cast<uint>(group.next->fetchAndAddRelaxed(1)) % static_cast<uint>(count));
+
+      if (group.policy == LeastOutstanding)
+      {
+         //ties are broken by the round robin start index
+         int best = index;
+
+         for (int i = 1; i < count; ++i)
+         {
+            const int candidate = (index + i) % count;
+
+            if (group.outstanding.at(candidate)->load() < group.outstanding.at(best)->load())
+            {
+               best = candidate;
+            }
+         }
+
+         index = best;
+      }
+
+      if (lease)
+      {
+         const QSharedPointer<QAtomicInt> outstanding = group.outstanding.at(index); //the lease outlives a replaced group
+
+         outstanding->ref();
+
+         *lease = QSharedPointer<QAtomicInt>(outstanding.data(), [outstanding](QAtomicInt *counter) { counter->deref(); });
+      }
+
+      return getDatabase(group.connectionNames.at(index));
+   }
+
+   /*!
+   \brief Marks a write of the current thread: the thread reads from primary connections until its ReadYourWrites scope ends.
+
+   Called by Database::execNonQuery, PreparedQuery and INSERT / UPDATE / DELETE builders.
+   */
+   static void markWrite()
+   {
+      SqlFactory *factory = getInstance();
+
+      if (!factory->m_replicaGroups.load())
+         return;
+
+      StickyState &state = factory->m_readYourWrites.localData();
+
+      if (state.scopes > 0)
+      {
+         state.wrote = true;
+      }
+   }
+
+   /*!
+   \brief Expires thread-local connections of all threads not requested with SqlFactory::getDatabase for longer than maxIdleTime ms.
+
+   Use it to free server sessions held by threads parked in a thread pool. A connection is idle since the last SqlFactory::getDatabase call
+   of its thread if no Database, Transaction, QueryResult or PreparedQuery object uses it (see leaseConnection).
+
+   QSqlDatabase may be used only by its thread, so the method does not close the connections itself: an expired connection is closed
+   in its thread by a queued call as soon as the thread returns to its event loop, otherwise by the next SqlFactory::getDatabase call
+   of the thread. The connections stay registered in their threads and are reopened by SqlFactory::getDatabase.
+   \return Count of expired connections
+   */
+   int reapIdleConnections(int maxIdleTime)
+   {
+      QMutexLocker locker(&m_threadPoolsMutex);
+
+      const qint64 now = m_clock.elapsed();
+
+      int reaped = 0;
+
+      for (ThreadDBPool *threadDbPool : m_threadPools)
+      {
+         reaped += threadDbPool->reapIdle(now, maxIdleTime);
+      }
+
+      return reaped;
+   }
+
+   /*!
+   \brief Closes pooled, warmed up and keep-alive connections and the thread-local connections of the current thread.
+
+   Called automatically when QCoreApplication is destroyed (while the driver plugins are still loaded).
+   Applications without QCoreApplication call it before leaving main().
+   Thread-local connections of other threads are closed when the threads finish (or call releaseThreadConnections).
+   The settings stay configured: thread-local connections requested later are opened again, pools are recreated by the next SqlFactory::config call.
+   \warning Destroy PooledConnection handles, Database and Transaction objects first.
+   */
+   void shutdown()
+   {
+      QMap<QString, QSharedPointer<ConnectionPool>> pools;
+      QMap<QString, QSharedPointer<ConnectionPool>> warmConnections;
+      QMap<QString, QSqlDatabase> keepAliveConnections;
+
+      {
+         QMutexLocker locker(&mutex);
+
+         pools.swap(m_pools);
+         warmConnections.swap(m_warmConnections);
+         keepAliveConnections.swap(m_keepAliveConnections);
+      }
+
+      pools.clear(); //the last pool reference closes the idle connections
+      warmConnections.clear();
+
+      for (auto it = keepAliveConnections.begin(); it != keepAliveConnections.end(); ++it)
+      {
+         closeConnection(it.value());
+      }
+
+      releaseThreadConnections();
+   }
+
+   /*!
+   \brief Returns lease of db if it is a thread-local connection of the current thread (null lease otherwise).
+
+   SqlFactory::reapIdleConnections does not expire the connection while a lease copy is alive.
+   Taken by Database, Transaction, QueryResult and PreparedQuery objects.
+   */
+   static QSharedPointer<QAtomicInt> leaseConnection(const QSqlDatabase &db)
+   {
+      ThreadDBPool *threadDbPool = getInstance()->m_dbPool.hasLocalData() ? getInstance()->m_dbPool.localData() : nullptr;
+
+      return threadDbPool ? threadDbPool->lease(db.connectionName()) : QSharedPointer<QAtomicInt>();
+   }
+
+   /*!
+   \brief Closes and removes all thread-local connections of the current thread.
+
+   Worker frameworks call it before a thread is parked or reused for unrelated work.
+   The next SqlFactory::getDatabase call of the thread creates new connections.
+   */
+   void releaseThreadConnections()
+   {
+      if (m_dbPool.hasLocalData())
+      {
+         m_dbPool.setLocalData(nullptr); //deletes the pool of the current thread
+      }
+   }
+
+   /*!
+   \brief Returns statement cache of the current thread connection for connectionName (nullptr if the connection is not created yet)
+   \sa DBSetting::setStatementCacheCapacity
+   */
+   StatementCache *statementCache(const QString &connectionName = QSqlDatabase::defaultConnection)
+   {
+      ThreadDBPool *threadDbPool = m_dbPool.hasLocalData() ? m_dbPool.localData() : nullptr;
+
+      if (threadDbPool && threadDbPool->connectionExists(connectionName))
+      {
+         return threadDbPool->statementCache(threadDbPool->uniqueConnectionName(connectionName));
+      }
+
+      return nullptr;
+   }
+
+   /*!
+   \brief Prepares sql on db. Statement cache is used if db is a thread-local SqlFactory connection of the current thread.
+   \param db Connection
+   \param sql SQL statement string
+   \param[out] query Prepared query
+   \param forwardOnly Configure query as forwardOnly. Only forward only statements are cached.
+   \return Statement lease (null for not cached statements). Keep the lease while the query is in use.
+   \sa StatementCache
+   */
+   static QSharedPointer<QSqlQuery> prepareStatement(const QSqlDatabase &db, const QString &sql, QSqlQuery &query, bool forwardOnly = true)
+   {
+      ThreadDBPool *threadDbPool = getInstance()->m_dbPool.hasLocalData() ? getInstance()->m_dbPool.localData() : nullptr;
+
+      StatementCache *cache = (threadDbPool && forwardOnly) ? threadDbPool->statementCache(db.connectionName()) : nullptr;
+
+      if (cache && cache->capacity() > 0)
+      {
+         const QSharedPointer<QSqlQuery> statement = cache->acquire(db, sql);
+
+         query = *statement; //shares the prepared result with the cached statement
+
+         return statement;
+      }
+
+      query = QSqlQuery(db);
+      query.setForwardOnly(forwardOnly);
+      query.prepare(sql);
+
+      return QSharedPointer<QSqlQuery>();
+   }
+
+   /*!
+   \brief Checks out a connection from the pool configured for connectionName (see DBSetting::setPoolSize).
+
+   Waits for a returned connection up to DBSetting::setPoolWaitTimeout ms if the pool is exhausted.
+   \param connectionName Connection name used with SqlFactory::config
+   \throws DBException if no connection could be checked out in time or the connection failed to open
+   */
+   PooledConnection acquire(const QString &connectionName = QSqlDatabase::defaultConnection)
+   {
+      const QSharedPointer<ConnectionPool> pool = connectionPool(connectionName);
+
+      return acquire(connectionName, pool ? pool->settings().poolWaitTimeout : 0);
+   }
+
+   /*!
+   \brief Checks out a connection from the pool configured for connectionName, waits up to waitTimeout ms if the pool is exhausted.
+   \param connectionName Connection name used with SqlFactory::config
+   \param waitTimeout Wait timeout (ms), negative value means wait forever
+   \throws DBException if no connection could be checked out in time or the connection failed to open
+   */
+   PooledConnection acquire(const QString &connectionName, int waitTimeout)
+   {
+      const QSharedPointer<ConnectionPool> pool = connectionPool(connectionName);
+
+      QSqlError error(QLatin1String("Connection pool is not configured"), connectionName, QSqlError::ConnectionError);
+      QSqlDatabase db;
+
+      if (pool)
+      {
+         error = QSqlError();
+         db = pool->checkout(waitTimeout, &error);
+      }
+
+#ifdef DB_EXCEPTIONS_ENABLED
+
+      if (!db.isValid())
+         throw DBException(error);
+
+#endif
+
+      return PooledConnection(db.isValid() ? pool : QSharedPointer<ConnectionPool>(), db, error);
+   }
+
+   /*!
+   \brief Returns the pool configured for connectionName or null pointer if pool mode is disabled for the connection
+   */
+   QSharedPointer<ConnectionPool> connectionPool(const QString &connectionName = QSqlDatabase::defaultConnection)
+   {
+      QMutexLocker locker(&mutex);
+
+      return m_pools.value(connectionName);
+   }
+
+   /*!
+   \brief Closes idle pooled connections which exceeded DBSetting::setPoolMaxIdleTime limit.
+
+   Idle connections are also evicted on every SqlFactory::acquire call, use the method to shrink pools of idle applications.
+   */
+   void evictIdleConnections()
+   {
+      QList<QSharedPointer<ConnectionPool>> pools;
+
+      {
+         QMutexLocker locker(&mutex);
+
+         pools = m_pools.values();
+      }
+
+      for (const QSharedPointer<ConnectionPool> &pool : pools)
+      {
+         pool->evictIdle();
+      }
+   }
+
+   /*!
+   \brief Returns snapshot of connection counts, pool checkout / connection open latencies, open failures and statement cache hits
+   for each configured connection name.
+   \sa exportMetrics
+   */
+   MetricsSnapshot metrics()
+   {
+      QMap<QString, QSharedPointer<ConnectionPool>> pools;
+      QMap<QString, QSharedPointer<ConnectionMetrics>> counters;
+      QHash<QString, int> threadLocal;
+
+      {
+         QMutexLocker locker(&mutex);
+
+         pools = m_pools;
+      }
+
+      {
+         QMutexLocker locker(&m_metricsMutex);
+
+         counters = m_metrics;
+      }
+
+      {
+         QMutexLocker locker(&m_threadPoolsMutex);
+
+         for (const ThreadDBPool *threadDbPool : m_threadPools)
+         {
+            threadDbPool->countConnections(threadLocal);
+         }
+      }
+
+      MetricsSnapshot snapshot;
+
+      for (auto it = counters.constBegin(); it != counters.constEnd(); ++it)
+      {
+         const ConnectionMetrics &m = *it.value();
+
+         MetricsSnapshot::Connection connection;
+         connection.name = it.key();
+
+         const QSharedPointer<ConnectionPool> pool = pools.value(it.key());
+
+         if (pool)
+         {
+            connection.pooled = true;
+            connection.open   = pool->openCount();
+            connection.idle   = pool->idleCount();
+            connection.inUse  = qMax(0, connection.open - connection.idle);
+         }
+
+         connection.threadLocal = threadLocal.value(it.key());
+
+         connection.opens            = m.opens.load();
+         connection.openFailures     = m.openFailures.load();
+         connection.checkouts        = m.checkouts.load();
+         connection.checkoutTimeouts = m.checkoutTimeouts.load();
+         connection.cacheHits        = m.cacheHits.load();
+         connection.cacheMisses      = m.cacheMisses.load();
+         connection.openLatency      = MetricsSnapshot::histogram(m.openLatency);
+         connection.checkoutWait     = MetricsSnapshot::histogram(m.checkoutWait);
+
+         snapshot.connections.append(connection);
+      }
+
+      return snapshot;
+   }
+
+   /*!
+   \brief Writes the metrics snapshot to fileName (e.g. for the node exporter textfile collector)
+   \return false if the file could not be written
+   */
+   bool exportMetrics(const QString &fileName, MetricsSnapshot::Format format = MetricsSnapshot::Prometheus)
+   {
+      return metrics().writeToFile(fileName, format);
+   }
+
+   /*!
+   \brief Passes the serialized metrics snapshot to callback
+   */
+   void exportMetrics(const std::function<void(const QByteArray &)> &callback, MetricsSnapshot::Format format = MetricsSnapshot::Json)
+   {
+      callback(metrics().serialize(format));
+   }
+
+private:
+   typedef QMap<QString, DBSetting> Settings;
+
+   static const char *writeMutexProperty()
+   {
+      return "EasyQtSql_writeMutex"; //dynamic property of QSqlDriver
+   }
+
+   /*!
+   \brief Immutable value published to the threads without locking on the read path.
+
+   Each thread keeps a reference to the value it read last and takes the new one (under the mutex) when the version changes.
+   A replaced value is freed as soon as no thread refers to it anymore.
+   */
+   template<typename T>
+   class Snapshot
+   {
+      Q_DISABLE_COPY(Snapshot)
+
+   public:
+      Snapshot()
+      { }
+
+      /*!
+      \brief Returns the current value (nullptr if none is stored yet). The pointer is valid until the next load() call of the thread.
+      */
+      const T *load()
+      {
+         Cached &cached = m_cached.localData();
+
+         if (cached.version != m_version.loadAcquire())
+         {
+            QMutexLocker locker(&m_mutex);
+
+            cached.value   = m_value;
+            cached.version = m_version.load();
+         }
+
+         return cached.value.data();
+      }
+
+      QSharedPointer<const T> current() const
+      {
+         QMutexLocker locker(&m_mutex);
+
+         return m_value;
+      }
+
+      void store(const QSharedPointer<const T> &value)
+      {
+         QMutexLocker locker(&m_mutex);
+
+         m_value = value;
+
+         m_version.fetchAndAddRelease(1);
+      }
+
+   private:
+      struct Cached
+      {
+         QSharedPointer<const T> value;
+         int version = -1;
+      };
+
+      mutable QMutex m_mutex;
+      QSharedPointer<const T> m_value;
+      QAtomicInt m_version;
+      QThreadStorage<Cached> m_cached;
+   };
+
+   /*!
+   \brief Preloads the driver plugin and opens connections of a pool
+   */
+   class WarmupTask : public QRunnable
+   {
+   public:
+      WarmupTask(const QString &driverType, const QSharedPointer<ConnectionPool> &pool, int connections)
+         : m_driverType(driverType)
+         , m_pool(pool)
+         , m_connections(connections)
+      { }
+
+      void run() override
+      {
+         preloadDriver(m_driverType);
+
+         if (m_pool)
+         {
+            m_pool->warmup(m_connections);
+         }
+      }
+
+   private:
+      QString m_driverType;
+      QSharedPointer<ConnectionPool> m_pool;
+      int m_connections;
+   };
+
+   QMutex mutex;
+
+   Snapshot<Settings> m_settings;
+   QThreadStorage<ThreadDBPool*> m_dbPool;
+
+   struct ReplicaGroup
+   {
+      QStringList   connectionNames;
+      ReplicaPolicy policy = RoundRobin;
+
+      QSharedPointer<QAtomicInt> next;                //round robin counter
+      QList<QSharedPointer<QAtomicInt>> outstanding; //running read queries per replica
+   };
+
+   typedef QMap<QString, ReplicaGroup> ReplicaGroups;
+
+   struct StickyState
+   {
+      int  scopes = 0;
+      bool wrote  = false;
+   };
+
+   Snapshot<ReplicaGroups> m_replicaGroups;
+   QThreadStorage<StickyState> m_readYourWrites;
+
+   QMap<QString, QSqlDatabase> m_keepAliveConnections; //see DBSetting::setKeepAliveConnection
+   QAtomicInt m_serializedWrites; //set once a setting with serialized writes is configured
+
+   QMutex m_metricsMutex;
+   QMap<QString, QSharedPointer<ConnectionMetrics>> m_metrics; //never removed: pools and connections keep raw pointers
+
+   QMutex m_threadPoolsMutex;
+   QSet<ThreadDBPool*> m_threadPools; //pools of all threads, see reapIdleConnections
+   QElapsedTimer m_clock;
+   QMap<QString, QSharedPointer<ConnectionPool>> m_pools;
+   QMap<QString, QSharedPointer<ConnectionPool>> m_warmConnections;
+
+   QString m_defaultConnName;
+
+private:
+   SqlFactory()
+   {
+      m_clock.start();
+
+      qAddPostRoutine(&SqlFactory::shutdownInstance);
+   }
+
+   ~SqlFactory()
+   {
+      shutdown(); //no-op if QCoreApplication already called it
+   }
+
+   static void shutdownInstance()
+   {
+      getInstance()->shutdown();
+   }
+
+   /*!
+   \brief Returns counters of connectionName, creates them on the first call
+   */
+   ConnectionMetrics *connectionMetrics(const QString &connectionName)
+   {
+      QMutexLocker locker(&m_metricsMutex);
+
+      QSharedPointer<ConnectionMetrics> &metrics = m_metrics[connectionName];
+
+      if (!metrics)
+      {
+         metrics = QSharedPointer<ConnectionMetrics>(new ConnectionMetrics());
+      }
+
+      return metrics.data();
+   }
+
+   void registerThreadPool(ThreadDBPool *threadDbPool)
+   {
+      QMutexLocker locker(&m_threadPoolsMutex);
+
+      m_threadPools.insert(threadDbPool);
+   }
+
+   void unregisterThreadPool(ThreadDBPool *threadDbPool)
+   {
+      QMutexLocker locker(&m_threadPoolsMutex);
+
+      m_threadPools.remove(threadDbPool);
+   }
+
+   /*!
+   \brief Takes a warmed up connection for a new thread-local connection (invalid QSqlDatabase if there is none)
+   */
+   QSqlDatabase takeWarmConnection(const QString &connectionName)
+   {
+      QSharedPointer<ConnectionPool> pool;
+
+      {
+         QMutexLocker locker(&mutex);
+
+         pool = m_warmConnections.value(connectionName);
+      }
+
+      return pool ? pool->takeIdle() : QSqlDatabase();
+   }
+
+   /*!
+   \brief Loads the driver plugin of driverType, so the first connection does not pay for it
+   */
+   static void preloadDriver(const QString &driverType)
+   {
+      const QString connectionName = QLatin1String("EasyQtSql_preload") + QUuid::createUuid().toString();
+
+      QSqlDatabase::addDatabase(driverType, connectionName); //the plugin stays loaded by the Qt plugin loader
+
+      QSqlDatabase::removeDatabase(connectionName);
+   }
+
+   static QSqlDatabase createConnection(const DBSetting &settings, const QString &uniqueConnectionName)
+   {
+      QSqlDatabase db = QSqlDatabase::addDatabase(settings.getType(), uniqueConnectionName);
+
+      db.setDatabaseName(settings.dbName);
+      db.setHostName(settings.host);
+      db.setUserName(settings.username);
+      db.setPassword(settings.password);
+
+      if (settings.port.isValid())
+      {
+         db.setPort(settings.port.toInt());
+      }
+
+      if (!settings.connectOptions.isEmpty())
+      {
+         db.setConnectOptions(settings.connectOptions);
+      }
+
+      if (settings.writeMutex && db.driver())
+      {
+         //the setting copy of the connection keeps the mutex alive
+         db.driver()->setProperty(writeMutexProperty(), QVariant::fromValue(static_cast<void*>(settings.writeMutex.data())));
+      }
+
+      return db;
+   }
+
+   /*!
+   \brief Returns the write mutex of the connection driver (see DBSetting::setSerializedWrites) or nullptr
+   */
+   static WriteMutex *writeMutex(const QSqlDriver *driver)
+   {
+      if (!driver || !getInstance()->m_serializedWrites.loadAcquire())
+      {
+         return nullptr;
+      }
+
+      return static_cast<WriteMutex*>(driver->property(writeMutexProperty()).value<void*>());
+   }
+
+   /*!
+   \brief Opens db and executes DBSetting init statements on it
+   \return Open error or the error of the first failed init statement (invalid QSqlError on success)
+   */
+   static QSqlError openConnection(QSqlDatabase &db, const DBSetting &settings)
+   {
+      if (!db.open())
+      {
+         return db.lastError();
+      }
+
+      for (const QString &statement : settings.initStatements)
+      {
+         QSqlQuery query(db);
+
+         if (!query.exec(statement))
+         {
+            return query.lastError();
+         }
+      }
+
+      return QSqlError();
+   }
+
+   /*!
+   \brief Opens db, failed attempts are retried with exponential backoff (see DBSetting::setReconnectBackoff)
+   \return Error of the last attempt (invalid QSqlError on success)
+   */
+   static QSqlError reconnect(QSqlDatabase &db, const DBSetting &settings, ConnectionMetrics *metrics)
+   {
+      int delay = settings.reconnectInitialDelay;
+
+      QSqlError error;
+
+      for (int attempt = 1; ; ++attempt)
+      {
+         QElapsedTimer openTimer;
+         openTimer.start();
+
+         error = openConnection(db, settings);
+
+         if (error.isValid())
+         {
+            metrics->openFailures.fetchAndAddRelaxed(1);
+         }
+         else
+         {
+            metrics->opens.fetchAndAddRelaxed(1);
+            metrics->openLatency.record(openTimer.nsecsElapsed() / 1000);
+         }
+
+         if (!error.isValid() || attempt >= settings.reconnectAttempts)
+         {
+            return error;
+         }
+
+         qWarning() << "Reconnect attempt" << attempt << "failed:" << error.text();
+
+         if (db.isOpen())
+         {
+            db.close(); //an init statement failed
+         }
+
+         QThread::msleep(static_cast<unsigned long>(delay));
+
+         delay = qMin(delay * 2, settings.reconnectMaxDelay);
+      }
+   }
+
+   /*!
+   \brief Returns true if the connection exceeded DBSetting::setMaxLifetime or DBSetting::setMaxUses limits
+   */
+   static bool isExpired(const ConnectionHealth &health, const DBSetting &settings)
+   {
+      return (settings.maxLifetime >= 0 && health.opened.hasExpired(settings.maxLifetime))
+            || (settings.maxUses > 0 && health.uses >= settings.maxUses);
+   }
+
+   /*!
+   \brief Checks db is open and runs the validation query if the last validation is older than DBSetting::setValidationInterval
+   \return false if the connection is closed or broken
+   */
+   static bool validateConnection(QSqlDatabase &db, const DBSetting &settings, ConnectionHealth &health)
+   {
+      if (!db.isOpen())
+      {
+         return false;
+      }
+
+      if (settings.validationInterval < 0
+          || (settings.validationInterval > 0 && !health.validated.hasExpired(settings.validationInterval)))
+      {
+         return true;
+      }
+
+      QSqlQuery query(db);
+
+      if (!query.exec(settings.validationQuery))
+      {
+         qWarning() << "Connection validation failed:" << query.lastError().text();
+
+         return false;
+      }
+
+      health.validated.restart();
+
+      return true;
+   }
+
+   static void closeConnection(QSqlDatabase &db)
+   {
+      const QString connectionName = db.connectionName();
+
+      if (db.isOpen())
+      {
+         db.close();
+      }
+
+      db = QSqlDatabase(); //release the last reference before removeDatabase
+
+      QSqlDatabase::removeDatabase(connectionName);
+   }
 };
 
 
@@ -0,0 +1,201 @@
+#ifndef EASYQTSQL_STATEMENTCACHE_H
+#define EASYQTSQL_STATEMENTCACHE_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include "EasyQtSql_Metrics.h"
+
+#endif
+
+/*!
+\brief LRU cache of prepared statements of a single connection. The cache is keyed by SQL text.
+
+SqlFactory creates a cache for each thread-local connection (see SqlFactory::DBSetting::setStatementCacheCapacity).
+PreparedQuery, InsertQuery, UpdateQuery and DeleteQuery take already prepared statements from the cache of their connection,
+so the driver does not re-parse the same SQL text on every call.
+
+A statement is taken out of the cache while it is in use: the lease returned by StatementCache::acquire (and all its copies) keeps it.
+The statement is finished and put back to the cache when the last lease copy is destroyed.
+
+\warning The cache is not thread safe. It belongs to the thread of its connection.
+\sa SqlFactory::prepareStatement, SqlFactory::statementCache
+*/
+class StatementCache : public QEnableSharedFromThis<StatementCache>
+{
+   Q_DISABLE_COPY(StatementCache)
+
+public:
+   /*!
+   \param capacity Max count of cached idle statements
+   \param metrics Counters of the connection name the hits and misses are added to (optional)
+   */
+   explicit StatementCache(int capacity, ConnectionMetrics *metrics = nullptr)
+      : m_statements(qMax(0, capacity))
+      , m_metrics(metrics)
+   { }
+
+   /*!
+   \brief Returns lease of a prepared (forward only) statement for sql. The statement is prepared on db if there is no idle cached one.
+   */
+   QSharedPointer<QSqlQuery> acquire(const QSqlDatabase &db, const QString &sql)
+   {
+      QSqlQuery *query = m_statements.take(sql);
+
+      if (query)
+      {
+         m_hits.fetchAndAddRelaxed(1);
+
+         if (m_metrics)
+            m_metrics->cacheHits.fetchAndAddRelaxed(1);
+      }
+      else
+      {
+         m_misses.fetchAndAddRelaxed(1);
+
+         if (m_metrics)
+            m_metrics->cacheMisses.fetchAndAddRelaxed(1);
+
+         query = new QSqlQuery(db);
+         query->setForwardOnly(true);
+
+         if (!query->prepare(sql))
+         {
+            return QSharedPointer<QSqlQuery>(query); //failed statements are not cached
+         }
+      }
+
+      return QSharedPointer<QSqlQuery>(query, Release(sharedFromThis(), sql));
+   }
+
+   /*!
+   \brief Returns max count of cached idle statements
+   */
+   int capacity() const
+   {
+      return m_statements.maxCost();
+   }
+
+   /*!
+   \brief Sets max count of cached idle statements. Least recently used statements are evicted. Zero capacity disables the cache.
+   */
+   void setCapacity(int capacity)
+   {
+      m_statements.setMaxCost(qMax(0, capacity));
+   }
+
+   /*!
+   \brief Returns count of cached idle statements
+   */
+   int size() const
+   {
+      return m_statements.size();
+   }
+
+   /*!
+   \brief Returns count of StatementCache::acquire calls served with a cached statement
+   */
+   quint64 hits() const
+   {
+      return m_hits.load();
+   }
+
+   /*!
+   \brief Returns count of StatementCache::acquire calls which prepared a new statement
+   */
+   quint64 misses() const
+   {
+      return m_misses.load();
+   }
+
+   /*!
+   \brief Returns count of statements evicted because of the capacity limit
+   */
+   quint64 evictions() const
+   {
+      return m_evictions.load();
+   }
+
+   /*!
+   \brief Removes all idle statements from the cache
+   */
+   void clear()
+   {
+      m_statements.clear();
+   }
+
+private:
+   struct Release
+   {
+      Release(const QSharedPointer<StatementCache> &cache, const QString &sql)
+         : cache(cache)
+         , sql(sql)
+      { }
+
+      void operator()(QSqlQuery *query) const
+      {
+         const QSharedPointer<StatementCache> strongCache = cache.toStrongRef();
+
+         if (strongCache)
+         {
+            strongCache->release(sql, query);
+         }
+         else
+         {
+            delete query;
+         }
+      }
+
+      QWeakPointer<StatementCache> cache;
+      QString sql;
+   };
+
+   void release(const QString &sql, QSqlQuery *query)
+   {
+      query->finish();
+
+      if (m_statements.maxCost() > 0
+          && !m_statements.contains(sql)
+          && m_statements.size() >= m_statements.maxCost())
+      {
+         m_evictions.fetchAndAddRelaxed(1);
+      }
+
+      m_statements.insert(sql, query); //takes ownership, deletes query if the capacity is zero
+   }
+
+   QCache<QString, QSqlQuery> m_statements;
+
+   QAtomicInteger<quint64> m_hits;
+   QAtomicInteger<quint64> m_misses;
+   QAtomicInteger<quint64> m_evictions;
+
+   ConnectionMetrics *m_metrics;
+};
+
+#endif // EASYQTSQL_STATEMENTCACHE_H
@@ -32,9 +32,14 @@
 #include "EasyQtSql_DBException.h"
 #include "EasyQtSql_NonQueryResult.h"
 #include "EasyQtSql_InsertQuery.h"
+#include "EasyQtSql_InsertStream.h"
+#include "EasyQtSql_UpsertQuery.h"
 #include "EasyQtSql_DeleteQuery.h"
 #include "EasyQtSql_UpdateQuery.h"
 #include "EasyQtSql_PreparedQuery.h"
+#include "EasyQtSql_KeysetPaginator.h"
+#include "EasyQtSql_SqlFactory.h"
+#include "EasyQtSql_SqlDialect.h"
 
 #endif
 
@@ -81,6 +86,8 @@ public:
    {
       m_db = db.isValid() ? db : QSqlDatabase::database();
 
+      m_connectionLease = SqlFactory::leaseConnection(m_db);
+
       if (!m_db.isOpen())
       {
          if (!m_db.open())
@@ -95,7 +102,10 @@ public:
    Database(Database&& other)
    {
       m_db = other.m_db;
+      m_primaryOnly = other.m_primaryOnly;
+      m_connectionLease = other.m_connectionLease;
       other.m_db = QSqlDatabase();
+      other.m_connectionLease.clear();
    }
 
    Database& operator=(Database&& other)
@@ -103,7 +113,10 @@ public:
       if (this == &other) return *this;
 
       m_db = other.m_db;
+      m_primaryOnly = other.m_primaryOnly;
+      m_connectionLease = other.m_connectionLease;
       other.m_db = QSqlDatabase();
+      other.m_connectionLease.clear();
 
       return *this;
    }
@@ -123,6 +136,10 @@ public:
    */
    NonQueryResult execNonQuery(const QString &sql) const
    {
+      SqlFactory::WriteLock writeLock(m_db);
+
+      SqlFactory::markWrite();
+
       QSqlQuery q = m_db.exec(sql);
 
 #ifdef DB_EXCEPTIONS_ENABLED
@@ -139,12 +156,18 @@ public:
 
    /*!
    \brief Executes SELECT query
+
+   The query runs on a read replica if replicas are configured for the connection (see SqlFactory::configReplicas).
    \param query SQL statement string
    \throws DBException
    */
    QueryResult execQuery(const QString &sql) const
    {
-      QSqlQuery q = m_db.exec(sql);
+      QSharedPointer<QAtomicInt> replicaLease;
+
+      const QSqlDatabase db = m_primaryOnly ? m_db : SqlFactory::getInstance()->readDatabase(m_db, &replicaLease);
+
+      QSqlQuery q = db.exec(sql);
 
 #ifdef DB_EXCEPTIONS_ENABLED
 
@@ -155,7 +178,11 @@ public:
 
 #endif
 
-      return QueryResult(q);
+      QueryResult res(q);
+      res.m_replicaLease = replicaLease;
+      res.m_connectionLease = replicaLease ? SqlFactory::leaseConnection(db) : m_connectionLease;
+
+      return res;
    }
 
    /*!
@@ -169,6 +196,32 @@ public:
       return query;
    }
 
+   /*!
+   \brief Creates streaming INSERT wrapper which flushes queued rows every flushRows rows or flushBytes bytes
+   \param table Table to insert into with list of columns
+   \param flushRows Max count of queued rows
+   \param flushBytes Max estimated size of queued values, zero disables the limit
+   \sa InsertStream
+   */
+   InsertStream insertStream(const QString &table, int flushRows = 10000, qint64 flushBytes = 16 * 1024 * 1024) const
+   {
+      InsertStream stream(table, m_db, flushRows, flushBytes);
+
+      return stream;
+   }
+
+   /*!
+   \brief Creates upsert (INSERT ... ON CONFLICT DO UPDATE) query wrapper
+   \param table Table to upsert into with list of columns
+   \sa UpsertQuery
+   */
+   UpsertQuery upsert(const QString &table) const
+   {
+      UpsertQuery query(table, m_db);
+
+      return query;
+   }
+
    /*!
    \brief Creates DELETE query wrapper
    \param table Table to delete from
@@ -203,6 +256,21 @@ public:
       return query;
    }
 
+   /*!
+   \brief Creates keyset (seek) paginator over SELECT query
+   \param query Base SELECT query without ORDER BY and LIMIT clauses
+   \param keyColumns Unique not NULL result columns the pages are ordered by
+   \param pageSize Max row count of a page
+   \param order Sort order of the key columns
+   \sa KeysetPaginator
+   */
+   KeysetPaginator paginate(const QString &query, const QStringList &keyColumns, int pageSize, Qt::SortOrder order = Qt::AscendingOrder) const
+   {
+      KeysetPaginator paginator(query, keyColumns, pageSize, m_db, order);
+
+      return paginator;
+   }
+
    /*!
     * \brief Returns a reference to the wrapped QSqlDatabase object
     */
@@ -250,13 +318,16 @@ public:
    template<typename Func>
    int first (const QString &query, Func&& f) const
    {
-      QueryResult res = execQuery(query);
-
-      return Util::first(res, f);
+      return range(query, 0, 1, f);
    }
 
    /*!
     \brief Executes <em>query</em> and applies function <em>f</em> to <em>count</em> result rows starting from index <em>start</em>.
+
+    The query is limited on the server side with the LIMIT/OFFSET clause of the database dialect (see SqlDialect::limitQuery),
+    so only the requested rows are computed and transferred.
+    If the query can not be rewritten safely, the full result is fetched and the rows are skipped on the client side.
+
     \param query SQL query string (SELECT statement)
     \param start Start index
     \param count Row count to handle
@@ -274,6 +345,15 @@ public:
    template<typename Func>
    int range(const QString &query, int start, int count, Func&& f) const
    {
+      const QString limitedQuery = SqlDialect(m_db).limitQuery(query, count, start);
+
+      if (!limitedQuery.isEmpty())
+      {
+         QueryResult res = execQuery(limitedQuery);
+
+         return Util::top(res, count, f);
+      }
+
       QueryResult res = execQuery(query);
 
       return Util::range(res, start, count, f);
@@ -297,9 +377,7 @@ public:
    template<typename Func>
    int top(const QString &query, int topCount, Func&& f) const
    {
-      QueryResult res = execQuery(query);
-
-      return Util::top(res, topCount, f);
+      return range(query, 0, topCount, f);
    }
 
    /*!
@@ -333,6 +411,8 @@ public:
 
 protected:
    QSqlDatabase m_db;
+   bool m_primaryOnly = false; //read queries are not routed to replicas
+   QSharedPointer<QAtomicInt> m_connectionLease; //see SqlFactory::leaseConnection
 };
 
 
@@ -406,6 +486,10 @@ public:
      , m_commited(false)
      , m_started(false)
    {      
+      m_primaryOnly = true;
+
+      m_writeLock = QSharedPointer<SqlFactory::WriteLock>(new SqlFactory::WriteLock(m_db)); //held until commit / rollback
+
       m_started = m_db.transaction();
 
       #ifdef DB_EXCEPTIONS_ENABLED
@@ -421,7 +505,11 @@ public:
    {
       m_commited = other.m_commited;
       m_started  = other.m_started;
+      m_writeLock = other.m_writeLock;
+
+      m_primaryOnly = true;
 
+      other.m_writeLock.clear();
       other.m_commited = false;
       other.m_started  = false;
    }
@@ -430,7 +518,9 @@ public:
    {
       m_started  = other.m_started;
       m_commited = other.m_commited;
+      m_writeLock = other.m_writeLock;
 
+      other.m_writeLock.clear();
       other.m_commited = false;
       other.m_started  = false;
 
@@ -443,6 +533,8 @@ public:
       {
          m_db.rollback();
       }
+
+      m_writeLock.clear();
    }
 
    /*!
@@ -458,6 +550,9 @@ public:
       {
          m_commited = m_db.commit();
 
+         if (m_commited)
+            m_writeLock.clear();
+
 #ifdef DB_EXCEPTIONS_ENABLED
 
          if (!m_commited)
@@ -482,6 +577,8 @@ public:
          res = m_db.rollback();
 
          m_commited = false;
+
+         m_writeLock.clear();
       }
 
       return res;
@@ -506,6 +603,7 @@ public:
 private:   
    bool m_commited = false;
    bool m_started = false;   
+   QSharedPointer<SqlFactory::WriteLock> m_writeLock; //see DBSetting::setSerializedWrites
 };
 
 #endif // EASYQTSQL_TRANSACTION_H
@@ -30,6 +30,7 @@
 
 #include <QtSql>
 #include "EasyQtSql_NonQueryResult.h"
+#include "EasyQtSql_SqlFactory.h"
 
 #endif
 
@@ -41,6 +42,7 @@ class  UpdateQuery
 public:
    UpdateQuery(const QString &table, const QSqlDatabase &db)
      : q(db)
+     , m_db(db)
      , m_table(table)
    {   }
 
@@ -113,7 +115,7 @@ public:
    \param last Parameter to bind on WHERE expression
 
    The method supports variable count of QVariant parameters.
-   Parameters are bound with <em>QSqlQuery::addBindValue</em>.
+   Parameters are bound positionally with <em>QSqlQuery::bindValue</em>.
    \code
    //UPDATE table SET a=111, b=222 WHERE a=1 AND b=2
    t.update("table")
@@ -154,18 +156,24 @@ public:
          sql += " WHERE " + m_whereExpr;
       }
 
-      q.prepare(sql);
+      m_statement = SqlFactory::prepareStatement(m_db, sql, q);
+
+      int index = 0;
 
       for (auto it = m_updateMap.begin(); it != m_updateMap.end(); ++it)
       {
-         q.addBindValue(it.value());
+         q.bindValue(index++, it.value());
       }
 
       for (auto it = m_params.begin(); it != m_params.end(); ++it)
       {
-         q.addBindValue(*it);
+         q.bindValue(index++, *it);
       }
 
+      SqlFactory::WriteLock writeLock(m_db);
+
+      SqlFactory::markWrite();
+
       bool res = q.exec();
 
 #ifdef DB_EXCEPTIONS_ENABLED
@@ -175,11 +183,13 @@ public:
 
 #endif
 
-      return NonQueryResult(q);
+      return NonQueryResult(q, m_statement);
    }
 
 private:
    QSqlQuery q;
+   QSqlDatabase m_db;
+   QSharedPointer<QSqlQuery> m_statement; //cached statement lease (see StatementCache)
    QString m_table;
    QVariantMap m_updateMap;
    QVariantList m_params;
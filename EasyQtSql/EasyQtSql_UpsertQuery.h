@@ -0,0 +1,367 @@
+#ifndef EASYQTSQL_UPSERTQUERY_H
+#define EASYQTSQL_UPSERTQUERY_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include "EasyQtSql_DBException.h"
+#include "EasyQtSql_InsertQuery.h"
+#include "EasyQtSql_SqlDialect.h"
+
+#endif
+
+/*!
+\brief QSqlQuery wrapper for <em>INSERT ... ON CONFLICT DO UPDATE</em> (upsert) query execution.
+
+Rows which conflict with existing rows on the conflict target columns update the existing rows, other rows are inserted.
+The statement is generated for the dialect of the connection:
+
+- SQLite 3.24+ and PostgreSQL 9.5+: <em>INSERT INTO table (...) VALUES ... ON CONFLICT (keys) DO UPDATE SET ...</em>
+- MySQL and MariaDB: <em>INSERT INTO table (...) VALUES ... ON DUPLICATE KEY UPDATE ...</em> (see UpsertQuery::setRowAlias)
+- SQL Server (QODBC, QTDS), DB2: <em>MERGE INTO table USING (VALUES (CAST(? AS type), ...) ...) ...</em>, the column types must be declared with UpsertQuery::columnType
+- Oracle: <em>MERGE INTO table USING (SELECT ... FROM dual UNION ALL ...) ...</em>
+
+Rows are queued and executed like InsertQuery rows: with QSqlQuery::execBatch or multi-row statements (see InsertQuery::setBatchMode),
+the statements are prepared once and reused. Non-key columns are updated with the inserted values by default.
+
+\code
+//INSERT INTO table (k, n, d) VALUES (?,?,?),(?,?,?) ON CONFLICT (k) DO UPDATE SET n = table.n + excluded.n
+t.upsert("table (k, n, d)")
+      .onConflict(QStringList() << "k")
+      .update("n", UpsertQuery::Increment)
+      .update("d", UpsertQuery::Keep)
+      .setBatchMode(InsertQuery::MultiRowValues)
+      .values(1, 10, "a")
+      .values(2, 20, "b")
+      .exec();
+\endcode
+\note The table must have a column list, the conflict target columns must have a unique constraint (PRIMARY KEY or UNIQUE index).
+NonQueryResult::insertedIds are available only if the key column is in the column list (see InsertQuery::returningIds).
+PostgreSQL, SQL Server and Oracle reject a multi-row statement which affects the same row twice, so keys of a chunk must be unique.
+\sa Database::upsert
+*/
+class UpsertQuery : public InsertQuery
+{
+public:
+   /*!
+   \brief Update rules of a non-key column of a conflicting row
+   */
+   enum UpdateRule
+   {
+      Replace,   //!< column = inserted value (default)
+      Increment, //!< column = column + inserted value
+      Keep       //!< column is not updated
+   };
+
+   UpsertQuery(const QString &table, const QSqlDatabase &db)
+      : InsertQuery(table, db)
+      , m_dialect(db)
+   { }
+
+   /*!
+   \brief Sets conflict target columns
+   */
+   UpsertQuery &onConflict(const QStringList &keyColumns)
+   {
+      m_keyColumns.clear();
+
+      for (const QString &column : keyColumns)
+      {
+         m_keyColumns.append(column.trimmed());
+      }
+
+      return *this;
+   }
+
+   /*!
+   \brief Sets update rule of column
+   */
+   UpsertQuery &update(const QString &column, UpdateRule rule = Replace)
+   {
+      m_rules.insert(column.trimmed().toLower(), rule);
+
+      return *this;
+   }
+
+   /*!
+   \brief Keeps all conflicting rows unchanged, only not conflicting rows are inserted
+   */
+   UpsertQuery &doNothing()
+   {
+      m_doNothing = true;
+
+      return *this;
+   }
+
+   /*!
+   \brief Declares SQL type of column, the parameter markers of the column are cast to the type in MERGE statements
+
+   SQL Server and DB2 can not infer the types of untyped parameter markers of the <em>USING (VALUES ...)</em> source rows,
+   so the types of all columns must be declared for these dialects. The types are optional for Oracle and not used by other dialects.
+   \code
+   //MERGE INTO table AS target USING (VALUES (CAST(? AS INTEGER),CAST(? AS VARCHAR(100)))) AS source (k, d) ...
+   t.upsert("table (k, d)")
+         .onConflict(QStringList() << "k")
+         .columnType("k", "INTEGER")
+         .columnType("d", "VARCHAR(100)");
+   \endcode
+   */
+   UpsertQuery &columnType(const QString &column, const QString &sqlType)
+   {
+      m_types.insert(column.trimmed().toLower(), sqlType.trimmed());
+
+      return *this;
+   }
+
+   /*!
+   \brief Sets MySQL row alias of the inserted values
+
+   The inserted values are referenced with the <em>VALUES(column)</em> function by default, which is deprecated since MySQL 8.0.20
+   but is the only form supported by MariaDB and MySQL before 8.0.19. Set the alias for MySQL 8.0.19+ to use the row alias syntax instead.
+   An empty alias restores the default.
+   \code
+   //INSERT INTO table (k, n) VALUES (?,?) AS new ON DUPLICATE KEY UPDATE n = new.n
+   t.upsert("table (k, n)").onConflict(QStringList() << "k").setRowAlias("new");
+   \endcode
+   */
+   UpsertQuery &setRowAlias(const QString &alias)
+   {
+      m_rowAlias = alias.trimmed();
+
+      return *this;
+   }
+
+   /*!
+   \brief Overrides the dialect detected from the connection (e.g. for ODBC drivers which do not report the DBMS type)
+   */
+   UpsertQuery &setDialect(const SqlDialect &dialect)
+   {
+      m_dialect = dialect;
+
+      return *this;
+   }
+
+   /*!
+   \brief Returns generated statement with rowCount rows
+   \throws DBException if the dialect does not support upserts, the table has no column list, the conflict target is not set
+   or a column type required by the dialect is not declared (see UpsertQuery::columnType)
+   */
+   QString sql(int rowCount = 1) const
+   {
+      return createSql(rowCount);
+   }
+
+protected:
+   QString createSql(int rowCount) const override
+   {
+      const int open = m_table.indexOf(QLatin1Char('('));
+      const int close = m_table.lastIndexOf(QLatin1Char(')'));
+
+      if (open < 0 || close < open || m_keyColumns.isEmpty())
+         return error(QLatin1String("Upsert requires a table column list and conflict target columns"));
+
+      const QString table = m_table.left(open).trimmed();
+
+      QStringList columns;
+
+      for (const QString &column : m_table.mid(open + 1, close - open - 1).split(QLatin1Char(',')))
+      {
+         columns.append(column.trimmed());
+      }
+
+      const QString rows = placeholderRows(columns.count(), rowCount);
+
+      switch (m_dialect.type())
+      {
+      case SqlDialect::SQLite:
+      case SqlDialect::PostgreSql:
+      {
+         const QStringList assignments = updateAssignments(columns, table + QLatin1Char('.'), QLatin1String("excluded."), QString());
+
+         return QString("INSERT INTO %1 VALUES %2 ON CONFLICT (%3) %4")
+               .arg(m_table, rows, m_keyColumns.join(QLatin1String(", ")),
+                    assignments.isEmpty() ? QString("DO NOTHING") : QString("DO UPDATE SET %1").arg(assignments.join(QLatin1String(", "))));
+      }
+
+      case SqlDialect::MySql:
+      {
+         QStringList assignments = m_rowAlias.isEmpty()
+               ? updateAssignments(columns, QString(), QLatin1String("VALUES("), QLatin1String(")"))
+               : updateAssignments(columns, QString(), m_rowAlias + QLatin1Char('.'), QString());
+
+         if (assignments.isEmpty()) //no-op update keeps the conflicting row
+            assignments.append(QString("%1 = %1").arg(m_keyColumns.first()));
+
+         return QString("INSERT INTO %1 VALUES %2%3 ON DUPLICATE KEY UPDATE %4")
+               .arg(m_table, rows, m_rowAlias.isEmpty() ? QString() : QString(" AS %1").arg(m_rowAlias), assignments.join(QLatin1String(", ")));
+      }
+
+      case SqlDialect::SqlServer:
+      case SqlDialect::Db2:
+      case SqlDialect::Oracle:
+      {
+         //typed parameter markers of the source rows
+         QStringList markers;
+
+         for (const QString &column : columns)
+         {
+            const QString type = m_types.value(column.toLower());
+
+            if (type.isEmpty() && m_dialect.type() != SqlDialect::Oracle)
+               return error(QString("Type of column %1 is required for MERGE, see UpsertQuery::columnType").arg(column));
+
+            markers.append(type.isEmpty() ? QString("?") : QString("CAST(? AS %1)").arg(type));
+         }
+
+         QString source;
+
+         if (m_dialect.type() == SqlDialect::Oracle)
+         {
+            QStringList items;
+
+            for (int i = 0; i < columns.count(); ++i)
+            {
+               items.append(markers.at(i) + QLatin1Char(' ') + columns.at(i));
+            }
+
+            const QString select = QString("SELECT %1 FROM dual").arg(items.join(QLatin1String(", ")));
+
+            QStringList selects;
+
+            for (int i = 0; i < rowCount; ++i)
+            {
+               selects.append(select);
+            }
+
+            source = QString("(%1) source").arg(selects.join(QLatin1String(" UNION ALL ")));
+         }
+         else
+         {
+            const QString row = QString("(%1)").arg(markers.join(QLatin1Char(',')));
+
+            QStringList typedRows;
+
+            for (int i = 0; i < rowCount; ++i)
+            {
+               typedRows.append(row);
+            }
+
+            source = QString("(VALUES %1) AS source (%2)").arg(typedRows.join(QLatin1Char(',')), columns.join(QLatin1String(", ")));
+         }
+
+         QStringList matches;
+
+         for (const QString &key : m_keyColumns)
+         {
+            matches.append(QString("target.%1 = source.%1").arg(key));
+         }
+
+         QStringList sourceColumns;
+
+         for (const QString &column : columns)
+         {
+            sourceColumns.append(QLatin1String("source.") + column);
+         }
+
+         const QStringList assignments = updateAssignments(columns, QLatin1String("target."), QLatin1String("source."), QString());
+
+         QString sql = QString("MERGE INTO %1 %2 USING %3 ON (%4)")
+               .arg(table, m_dialect.type() == SqlDialect::Oracle ? QString("target") : QString("AS target"), source, matches.join(QLatin1String(" AND ")));
+
+         if (!assignments.isEmpty())
+            sql += QString(" WHEN MATCHED THEN UPDATE SET %1").arg(assignments.join(QLatin1String(", ")));
+
+         sql += QString(" WHEN NOT MATCHED THEN INSERT (%1) VALUES (%2)").arg(columns.join(QLatin1String(", ")), sourceColumns.join(QLatin1String(", ")));
+
+         if (m_dialect.type() == SqlDialect::SqlServer)
+            sql += QLatin1Char(';'); //MERGE must be terminated
+
+         return sql;
+      }
+
+      default:
+         return error(QLatin1String("Upsert is not supported by the database dialect"));
+      }
+   }
+
+   bool isPlainInsert() const override
+   {
+      return false;
+   }
+
+private:
+   SqlDialect m_dialect;
+   QStringList m_keyColumns;
+   QHash<QString, UpdateRule> m_rules;
+   QHash<QString, QString> m_types;
+   QString m_rowAlias;
+   bool m_doNothing = false;
+
+   //SET expressions of the non-key columns, target/inserted values are referenced with the prefixes (and suffix)
+   QStringList updateAssignments(const QStringList &columns, const QString &targetPrefix, const QString &insertedPrefix, const QString &insertedSuffix) const
+   {
+      QStringList assignments;
+
+      if (m_doNothing)
+         return assignments;
+
+      for (const QString &column : columns)
+      {
+         if (m_keyColumns.contains(column, Qt::CaseInsensitive))
+            continue;
+
+         const UpdateRule rule = m_rules.value(column.toLower(), Replace);
+
+         const QString inserted = insertedPrefix + column + insertedSuffix;
+
+         if (rule == Replace)
+         {
+            assignments.append(QString("%1 = %2").arg(column, inserted));
+         }
+         else if (rule == Increment)
+         {
+            assignments.append(QString("%1 = %2%1 + %3").arg(column, targetPrefix, inserted));
+         }
+      }
+
+      return assignments;
+   }
+
+   static QString error(const QString &text)
+   {
+#ifdef DB_EXCEPTIONS_ENABLED
+      throw DBException(QSqlError(QString(), text, QSqlError::StatementError));
+#endif
+
+      Q_UNUSED(text)
+
+      return QString(); //the statement fails on execution
+   }
+};
+
+#endif // EASYQTSQL_UPSERTQUERY_H
@@ -79,6 +79,8 @@ public:
 
    /*!
    \brief Applies function (lambda) f to count rows starting from start index
+
+   The rows before start are fetched and skipped on the client side. Database::range limits the query on the server side instead.
    \param res QueryResult 
    \param start Index of start row
    \param count Rows count
@@ -135,8 +137,492 @@ public:
       return top(res, 1, f);
    }
 
+   /*!
+   \brief Copy of a result row handed to the worker threads of Util::parallelEach and Util::parallelMapReduce
+   */
+   class RowSnapshot
+   {
+      friend class Util;
+
+   public:
+      /*!
+      \brief Returns the value of column
+      */
+      QVariant value(int column) const
+      {
+         return (column >= 0 && column < m_count) ? m_values[column] : QVariant();
+      }
+
+      /*!
+      \brief Returns the value of the field called name (case insensitive)
+      */
+      QVariant value(const QString &colName) const
+      {
+         return value(m_columns->value(colName.toLower(), -1));
+      }
+
+      /*!
+      \brief Returns the value of column converted to type T with ValueConverter<T>
+      */
+      template<typename T>
+      T get(int column) const
+      {
+         return ValueConverter<T>::convert(value(column));
+      }
+
+      /*!
+      \brief Returns count of columns
+      */
+      int count() const
+      {
+         return m_count;
+      }
+
+      /*!
+      \brief Returns index of the row in the result (the first fetched row is 0)
+      */
+      int index() const
+      {
+         return m_index;
+      }
+
+   private:
+      RowSnapshot(const QVariant *values, int count, const QHash<QString, int> *columns, int index)
+         : m_values(values)
+         , m_count(count)
+         , m_columns(columns)
+         , m_index(index)
+      { }
+
+      const QVariant *m_values;
+      int m_count;
+      const QHash<QString, int> *m_columns;
+      int m_index;
+   };
+
+   /*!
+   \brief Order of Util::parallelMapReduce reduce calls
+   */
+   enum ReduceOrder
+   {
+      UnorderedReduce, //!< Mapped values are reduced as soon as their batch is mapped
+      OrderedReduce    //!< Mapped values are reduced in the row order
+   };
+
+   /*!
+   \brief Applies function (lambda) f to each row in res on the threads of pool.
+
+   Rows are fetched on the calling thread (the thread of the connection) and handed to the pool in batches of batchSize rows.
+   f is called concurrently for rows of different batches, in no particular order, with Util::RowSnapshot of the row.
+   The method returns when all the rows are processed.
+
+   A batch is handed only to an idle thread of pool (QThreadPool::tryStart), the calling thread processes it itself otherwise.
+   So the method can be called from a thread of pool, even if the pool has no other free thread.
+
+   \code
+   QueryResult res = t.execQuery("SELECT id, payload FROM events");
+
+   Util::parallelEach(res, [](const Util::RowSnapshot &row)
+   {
+      parsePayload(row.get<qint64>(0), row.value(1).toByteArray());
+   });
+   \endcode
+
+   \param res QueryResult
+   \param f Function, must be thread safe
+   \param batchSize Count of rows handed to a pool thread at once
+   \param pool Thread pool
+   \return Count of processed rows
+   \throws The first exception thrown by f, rethrown on the calling thread after the started batches finish
+   */
+   template<typename Func>
+   static int parallelEach(QueryResult &res, Func&& f, int batchSize = 256, QThreadPool *pool = QThreadPool::globalInstance())
+   {
+      typedef typename std::remove_reference<Func>::type Function;
+      typedef ParallelState<int> State; //no mapped values
+
+      int rowCount = 0;
+
+      if (!res.isActive())
+         return rowCount;
+
+      const QSharedPointer<State> state(new State);
+      const int maxInFlight = qMax(1, pool->maxThreadCount()) * 2; //bounds the memory of fetched rows
+      Function *func = &f; //outlives the tasks: the method waits for them
+
+      QSharedPointer<const QHash<QString, int>> columns;
+
+      try
+      {
+         for (;;)
+         {
+            const QSharedPointer<RowBatch> batch(new RowBatch);
+
+            if (!fetchBatch(res, *batch, qMax(1, batchSize), rowCount, columns))
+               break;
+
+            rowCount += batch->rowCount;
+
+            {
+               QMutexLocker locker(&state->mutex);
+
+               while (state->inFlight >= maxInFlight && !state->error)
+               {
+                  state->finished.wait(&state->mutex);
+               }
+
+               if (state->error)
+                  break; //f failed, no more batches
+
+               ++state->inFlight;
+            }
+
+            startTask(pool, [batch, state, func]()
+            {
+               std::exception_ptr error;
+
+               try
+               {
+                  for (int i = 0; i < batch->rowCount; ++i)
+                  {
+                     (*func)(batch->row(i));
+                  }
+               }
+               catch (...)
+               {
+                  error = std::current_exception(); //an exception must not leave QRunnable::run
+               }
+
+               QMutexLocker locker(&state->mutex);
+
+               if (error && !state->error)
+                  state->error = error;
+
+               --state->inFlight;
+
+               state->finished.wakeAll();
+            });
+         }
+      }
+      catch (...)
+      {
+         waitInFlight(state);
+         throw;
+      }
+
+      waitInFlight(state);
+
+      rethrowError(state);
+
+      return rowCount;
+   }
+
+   /*!
+   \brief Maps rows of res on the threads of pool and reduces the mapped values on the calling thread.
+
+   Rows are fetched on the calling thread and handed to the pool in batches of batchSize rows.
+   map is called concurrently with Util::RowSnapshot of the row and returns the mapped value.
+   reduce(result, mappedValue) is called on the calling thread only, in the row order if order is Util::OrderedReduce.
+   As in Util::parallelEach, a batch is mapped on the calling thread if pool has no idle thread.
+
+   \code
+   QueryResult res = t.execQuery("SELECT id, geometry FROM parcels");
+
+   const double totalArea = Util::parallelMapReduce(res,
+      [](const Util::RowSnapshot &row) { return area(row.value(1).toByteArray()); },
+      [](double &total, double area) { total += area; },
+      0.0);
+   \endcode
+
+   \param res QueryResult
+   \param map Map function, must be thread safe
+   \param reduce Reduce function
+   \param init Initial result value
+   \param order Order of reduce calls
+   \param batchSize Count of rows handed to a pool thread at once
+   \param pool Thread pool
+   \return Reduced result
+   \throws The first exception thrown by map, rethrown on the calling thread after the started batches finish
+   */
+   template<typename T, typename MapFunc, typename ReduceFunc>
+   static T parallelMapReduce(QueryResult &res, MapFunc&& map, ReduceFunc&& reduce, T init = T(), ReduceOrder order = UnorderedReduce, int batchSize = 256, QThreadPool *pool = QThreadPool::globalInstance())
+   {
+      typedef typename std::remove_reference<MapFunc>::type Function;
+      typedef typename std::decay<decltype(map(std::declval<const RowSnapshot&>()))>::type Mapped;
+      typedef ParallelState<Mapped> State;
+
+      T result = init;
+
+      if (!res.isActive())
+         return result;
+
+      const QSharedPointer<State> state(new State);
+      const int maxPending = qMax(1, pool->maxThreadCount()) * 2; //bounds the memory of fetched and mapped rows
+      Function *func = &map; //outlives the tasks: the method waits for them
+
+      QSharedPointer<const QHash<QString, int>> columns;
+
+      int rowCount = 0;
+      int submitted = 0;
+      int reduced = 0;
+
+      //reduces the mapped batches available, waits for one if wait is true. Returns false if map failed
+      auto reduceMapped = [&state, &reduce, &result, &reduced, order](bool wait)
+      {
+         QList<QVector<Mapped>> ready;
+
+         {
+            QMutexLocker locker(&state->mutex);
+
+            for (;;)
+            {
+               if (state->error)
+                  return false;
+
+               if (order == OrderedReduce)
+               {
+                  while (state->mapped.contains(reduced + ready.count()))
+                  {
+                     ready.append(state->mapped.take(reduced + ready.count()));
+                  }
+               }
+               else
+               {
+                  ready = state->mapped.values();
+                  state->mapped.clear();
+               }
+
+               if (!ready.isEmpty() || !wait)
+                  break;
+
+               state->finished.wait(&state->mutex);
+            }
+         }
+
+         reduced += ready.count();
+
+         for (const QVector<Mapped> &values : ready)
+         {
+            for (const Mapped &value : values)
+            {
+               reduce(result, value);
+            }
+         }
+
+         return true;
+      };
+
+      try
+      {
+         for (;;)
+         {
+            const QSharedPointer<RowBatch> batch(new RowBatch);
+
+            if (!fetchBatch(res, *batch, qMax(1, batchSize), rowCount, columns))
+               break;
+
+            rowCount += batch->rowCount;
+
+            bool mapping = true;
+
+            while (mapping && submitted - reduced >= maxPending)
+            {
+               mapping = reduceMapped(true);
+            }
+
+            if (!mapping)
+               break;
+
+            const int batchIndex = submitted++;
+
+            {
+               QMutexLocker locker(&state->mutex);
+               ++state->inFlight;
+            }
+
+            startTask(pool, [batch, state, func, batchIndex]()
+            {
+               QVector<Mapped> values;
+               values.reserve(batch->rowCount);
+
+               std::exception_ptr error;
+
+               try
+               {
+                  for (int i = 0; i < batch->rowCount; ++i)
+                  {
+                     values.append((*func)(batch->row(i)));
+                  }
+               }
+               catch (...)
+               {
+                  error = std::current_exception(); //an exception must not leave QRunnable::run
+               }
+
+               QMutexLocker locker(&state->mutex);
+
+               if (!error)
+                  state->mapped.insert(batchIndex, values);
+               else if (!state->error)
+                  state->error = error;
+
+               --state->inFlight;
+
+               state->finished.wakeAll();
+            });
+
+            if (!reduceMapped(false))
+               break;
+         }
+
+         while (reduced < submitted && reduceMapped(true))
+         { }
+      }
+      catch (...)
+      {
+         waitInFlight(state);
+         throw;
+      }
+
+      waitInFlight(state);
+
+      rethrowError(state);
+
+      return result;
+   }
+
 private:
    Util(){}
+
+   struct RowBatch
+   {
+      RowBatch()
+         : rowCount(0)
+         , firstRow(0)
+         , columnCount(0)
+      { }
+
+      RowSnapshot row(int i) const
+      {
+         return RowSnapshot(values.constData() + i * columnCount, columnCount, columns.data(), firstRow + i);
+      }
+
+      QVector<QVariant> values; //row-major
+      int rowCount;
+      int firstRow;
+      int columnCount;
+      QSharedPointer<const QHash<QString, int>> columns;
+   };
+
+   static bool fetchBatch(QueryResult &res, RowBatch &batch, int batchSize, int firstRow, QSharedPointer<const QHash<QString, int>> &columns)
+   {
+      while (batch.rowCount < batchSize && res.next())
+      {
+         if (!columns)
+         {
+            const QSqlRecord record = res.unwrappedQuery().record();
+
+            QHash<QString, int> *names = new QHash<QString, int>();
+
+            for (int i = record.count() - 1; i >= 0; --i)
+            {
+               names->insert(record.fieldName(i).toLower(), i); //the first column of duplicated names wins
+            }
+
+            columns = QSharedPointer<const QHash<QString, int>>(names);
+         }
+
+         if (batch.rowCount == 0)
+         {
+            batch.firstRow = firstRow;
+            batch.columnCount = res.unwrappedQuery().record().count();
+            batch.columns = columns;
+            batch.values.reserve(batchSize * batch.columnCount);
+         }
+
+         for (int i = 0; i < batch.columnCount; ++i)
+         {
+            batch.values.append(res.value(i));
+         }
+
+         ++batch.rowCount;
+      }
+
+      return batch.rowCount > 0;
+   }
+
+   template<typename Mapped>
+   struct ParallelState
+   {
+      ParallelState()
+         : inFlight(0)
+      { }
+
+      QMutex mutex;
+      QWaitCondition finished;
+      int inFlight;                      //batches handed to the pool and not processed yet
+      QMap<int, QVector<Mapped>> mapped; //mapped batches by batch index (Util::parallelMapReduce)
+      std::exception_ptr error;          //the first exception thrown by a batch
+   };
+
+   template<typename Func>
+   class Task : public QRunnable
+   {
+   public:
+      explicit Task(const Func &f)
+         : m_f(f)
+      { }
+
+      void run() override
+      {
+         m_f();
+      }
+
+   private:
+      Func m_f;
+   };
+
+   /*!
+   \brief Runs f on an idle thread of pool, or on the calling thread if there is none.
+
+   Tasks never wait in the pool queue: the caller may be a thread of the same pool waiting for the tasks.
+   */
+   template<typename Func>
+   static void startTask(QThreadPool *pool, const Func &f)
+   {
+      Task<Func> *task = new Task<Func>(f);
+
+      if (!pool->tryStart(task))
+      {
+         task->run();
+
+         delete task;
+      }
+   }
+
+   template<typename State>
+   static void rethrowError(const QSharedPointer<State> &state)
+   {
+      QMutexLocker locker(&state->mutex);
+
+      const std::exception_ptr error = state->error;
+
+      locker.unlock();
+
+      if (error)
+         std::rethrow_exception(error);
+   }
+
+   template<typename State>
+   static void waitInFlight(const QSharedPointer<State> &state)
+   {
+      QMutexLocker locker(&state->mutex);
+
+      while (state->inFlight > 0)
+      {
+         state->finished.wait(&state->mutex);
+      }
+   }
 };
 
 #endif // EASYQTSQL_UTIL_H
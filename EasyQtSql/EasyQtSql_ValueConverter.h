@@ -0,0 +1,141 @@
+#ifndef EASYQTSQL_VALUECONVERTER_H
+#define EASYQTSQL_VALUECONVERTER_H
+
+/*
+ * The MIT License (MIT)
+ * Copyright 2018 Alexey Kramin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+*/
+
+#ifndef EASY_QT_SQL_MAIN
+
+#include <QtSql>
+#include <tuple>
+
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+
+#endif
+
+/*!
+\brief Converts SQL values (QVariant) to C++ type T.
+
+The generic converter uses QVariant::value<T>(). Specializations call the matching QVariant::to*() method directly.
+std::optional<T> (C++17) is std::nullopt for SQL NULL values.
+
+Specialize the template to fetch your own types with QueryResult::get and QueryResult::fetchInto:
+
+\code
+template<>
+struct ValueConverter<Money>
+{
+   static Money convert(const QVariant &value)
+   {
+      return Money::fromCents(value.toLongLong());
+   }
+};
+\endcode
+
+\sa QueryResult::get, QueryResult::fetchInto
+*/
+template<typename T>
+struct ValueConverter
+{
+   static T convert(const QVariant &value)
+   {
+      return value.value<T>();
+   }
+};
+
+/// \cond
+#define EASY_QT_SQL_VALUE_CONVERTER(Type, method) \
+template<> \
+struct ValueConverter<Type> \
+{ \
+   static Type convert(const QVariant &value) \
+   { \
+      return static_cast<Type>(value.method()); \
+   } \
+};
+
+EASY_QT_SQL_VALUE_CONVERTER(bool, toBool)
+EASY_QT_SQL_VALUE_CONVERTER(short, toInt)
+EASY_QT_SQL_VALUE_CONVERTER(ushort, toUInt)
+EASY_QT_SQL_VALUE_CONVERTER(int, toInt)
+EASY_QT_SQL_VALUE_CONVERTER(uint, toUInt)
+EASY_QT_SQL_VALUE_CONVERTER(long, toLongLong)
+EASY_QT_SQL_VALUE_CONVERTER(ulong, toULongLong)
+EASY_QT_SQL_VALUE_CONVERTER(qint64, toLongLong)
+EASY_QT_SQL_VALUE_CONVERTER(quint64, toULongLong)
+EASY_QT_SQL_VALUE_CONVERTER(float, toFloat)
+EASY_QT_SQL_VALUE_CONVERTER(double, toDouble)
+EASY_QT_SQL_VALUE_CONVERTER(QString, toString)
+EASY_QT_SQL_VALUE_CONVERTER(QByteArray, toByteArray)
+EASY_QT_SQL_VALUE_CONVERTER(QDate, toDate)
+EASY_QT_SQL_VALUE_CONVERTER(QTime, toTime)
+EASY_QT_SQL_VALUE_CONVERTER(QDateTime, toDateTime)
+
+#undef EASY_QT_SQL_VALUE_CONVERTER
+
+template<>
+struct ValueConverter<QVariant>
+{
+   static QVariant convert(const QVariant &value)
+   {
+      return value;
+   }
+};
+
+#if __cplusplus >= 201703L
+
+template<typename T>
+struct ValueConverter<std::optional<T>>
+{
+   static std::optional<T> convert(const QVariant &value)
+   {
+      if (value.isNull())
+         return std::nullopt;
+
+      return ValueConverter<T>::convert(value);
+   }
+};
+
+#endif
+
+//compile-time sequence of column indexes (C++11 replacement of std::index_sequence)
+template<int... Indexes>
+struct IndexSequence
+{ };
+
+template<int N, int... Indexes>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indexes...>
+{ };
+
+template<int... Indexes>
+struct MakeIndexSequence<0, Indexes...>
+{
+   typedef IndexSequence<Indexes...> type;
+};
+/// \endcond
+
+#endif // EASYQTSQL_VALUECONVERTER_H
@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QtTest>
+
+//benchmark_* slots build large tables and print timings, they run only if EASYQTSQL_BENCHMARKS is set
+#define SKIP_UNLESS_BENCHMARKS() \
+   do { \
+      if (!qEnvironmentVariableIsSet("EASYQTSQL_BENCHMARKS")) \
+         QSKIP("Benchmark, set EASYQTSQL_BENCHMARKS=1 to run"); \
+   } while (0)
+
+#endif // BENCHMARK_H
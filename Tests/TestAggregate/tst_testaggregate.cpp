@@ -0,0 +1,427 @@
+#include <QtTest>
+#include "EasyQtSql.h"
+#include "../Shared/Benchmark.h"
+
+using namespace EasyQtSql;
+
+class TestAggregate : public QObject
+{
+   Q_OBJECT
+
+public:
+   TestAggregate(){}
+   ~TestAggregate(){}
+
+private slots:
+   void initTestCase();
+   void cleanupTestCase();
+   void test_case1();
+   void test_case2();
+   void test_case3();
+   void test_case4();
+   void test_case5();
+   void test_case6();
+   void benchmark_stats();
+   void benchmark_groupBy();
+
+private:
+   const int rowCount = 1000;
+
+   const char *selectQuery = "SELECT k, g, v, n FROM aggTable ORDER BY x";
+};
+
+void TestAggregate::initTestCase()
+{
+   QLatin1Literal driverName("QSQLITE");
+
+   if (!QSqlDatabase::drivers().contains(driverName))
+       QFAIL("This test requires the SQLITE database driver");
+
+   QSqlDatabase sdb = QSqlDatabase::addDatabase(driverName);
+
+   sdb.setDatabaseName(":memory:");
+
+   if (!sdb.open())
+   {
+      QFAIL(sdb.lastError().text().toStdString().c_str());
+   }
+
+   Transaction t(sdb);
+
+   t.execNonQuery("CREATE TABLE aggTable (x int, k text, g int, v real, n int)");
+
+   t.execNonQuery(QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                          "INSERT INTO aggTable SELECT x, CASE WHEN x % 11 = 0 THEN NULL ELSE 'key' || (x % 5) END, x % 7, x * 0.25, "
+                          "CASE WHEN x % 3 = 0 THEN NULL ELSE x - 500 END FROM cnt").arg(rowCount));
+
+   t.commit();
+}
+
+void TestAggregate::cleanupTestCase()
+{
+   {
+      QSqlDatabase sdb = QSqlDatabase::database(QSqlDatabase::defaultConnection);
+      if (sdb.isOpen())
+      {
+         sdb.close();
+      }
+   }
+
+   QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+}
+
+void TestAggregate::test_case1() //stats of double and int columns with NULL values
+{
+   Transaction t;
+
+   QueryResult res = t.execQuery(selectQuery);
+
+   const ColumnBatch batch = res.fetchColumns(rowCount);
+
+   QCOMPARE(batch.rowCount(), rowCount);
+
+   Aggregate::Stats v;
+   v.add(batch.column(2));
+
+   Aggregate::Stats n;
+   n.add(batch.column(3));
+
+   t.first("SELECT COUNT(v), SUM(v), MIN(v), MAX(v), AVG(v), COUNT(n), SUM(n), MIN(n), MAX(n), AVG(n), COUNT(*) FROM aggTable", [&v, &n](const QueryResult &row)
+   {
+      QCOMPARE(v.count(), row.value(0).toLongLong());
+      QCOMPARE(v.sum(), row.value(1).toDouble());
+      QCOMPARE(v.min(), row.value(2).toDouble());
+      QCOMPARE(v.max(), row.value(3).toDouble());
+      QCOMPARE(v.mean(), row.value(4).toDouble());
+      QCOMPARE(v.nullCount(), 0LL);
+
+      QCOMPARE(n.count(), row.value(5).toLongLong());
+      QCOMPARE(n.sum(), row.value(6).toDouble());
+      QCOMPARE(n.min(), row.value(7).toDouble());
+      QCOMPARE(n.max(), row.value(8).toDouble());
+      QCOMPARE(n.mean(), row.value(9).toDouble());
+      QCOMPARE(n.rowCount(), row.value(10).toLongLong());
+   });
+
+   Aggregate::Stats empty;
+   QCOMPARE(empty.count(), 0LL);
+   QVERIFY(qIsNaN(empty.min()));
+   QVERIFY(qIsNaN(empty.mean()));
+}
+
+void TestAggregate::test_case2() //stats accumulated over batches
+{
+   Transaction t;
+
+   QueryResult res = t.execQuery(selectQuery);
+
+   ColumnBatch batch;
+
+   Aggregate::Stats total;
+   Aggregate::Stats merged;
+
+   int batchCount = 0;
+
+   while (res.fetchColumns(batch, 97) > 0)
+   {
+      total.add(batch.column(3));
+
+      Aggregate::Stats part;
+      part.add(batch.column(3));
+      merged.merge(part);
+
+      ++batchCount;
+   }
+
+   QCOMPARE(batchCount, (rowCount + 96) / 97);
+
+   t.first("SELECT COUNT(n), SUM(n), MIN(n), MAX(n), COUNT(*) FROM aggTable", [&total, &merged](const QueryResult &row)
+   {
+      QCOMPARE(total.count(), row.value(0).toLongLong());
+      QCOMPARE(total.sum(), row.value(1).toDouble());
+      QCOMPARE(total.min(), row.value(2).toDouble());
+      QCOMPARE(total.max(), row.value(3).toDouble());
+      QCOMPARE(total.rowCount(), row.value(4).toLongLong());
+
+      QCOMPARE(merged.count(), total.count());
+      QCOMPARE(merged.sum(), total.sum());
+      QCOMPARE(merged.min(), total.min());
+      QCOMPARE(merged.max(), total.max());
+      QCOMPARE(merged.rowCount(), total.rowCount());
+   });
+}
+
+void TestAggregate::test_case3() //count distinct
+{
+   Transaction t;
+
+   QueryResult res = t.execQuery(selectQuery);
+
+   ColumnBatch batch;
+
+   Aggregate::CountDistinct k, g, v;
+
+   while (res.fetchColumns(batch, 128) > 0)
+   {
+      k.add(batch.column(0));
+      g.add(batch.column(1));
+      v.add(batch.column(2));
+   }
+
+   t.first("SELECT COUNT(DISTINCT k), COUNT(DISTINCT g), COUNT(DISTINCT v) FROM aggTable", [&k, &g, &v](const QueryResult &row)
+   {
+      QCOMPARE(k.count(), row.value(0).toLongLong());
+      QCOMPARE(g.count(), row.value(1).toLongLong());
+      QCOMPARE(v.count(), row.value(2).toLongLong());
+   });
+}
+
+void TestAggregate::test_case4() //group by integer key
+{
+   Transaction t;
+
+   QueryResult res = t.execQuery(selectQuery);
+
+   ColumnBatch batch;
+
+   Aggregate::GroupBy<qint64> groupBy;
+
+   while (res.fetchColumns(batch, 128) > 0)
+   {
+      groupBy.add(batch.column(1), batch.column(3));
+   }
+
+   QCOMPARE(groupBy.groups().count(), 7);
+   QCOMPARE(groupBy.nullGroup().rowCount(), 0LL);
+
+   const int count = t.each("SELECT g, COUNT(n), SUM(n), MIN(n), MAX(n), COUNT(*) FROM aggTable GROUP BY g", [&groupBy](const QueryResult &row)
+   {
+      const qint64 key = row.value(0).toLongLong();
+
+      QVERIFY(groupBy.groups().contains(key));
+
+      const Aggregate::Stats stats = groupBy.groups().value(key);
+
+      QCOMPARE(stats.count(), row.value(1).toLongLong());
+      QCOMPARE(stats.sum(), row.value(2).toDouble());
+      QCOMPARE(stats.min(), row.value(3).toDouble());
+      QCOMPARE(stats.max(), row.value(4).toDouble());
+      QCOMPARE(stats.rowCount(), row.value(5).toLongLong());
+   });
+
+   QCOMPARE(count, 7);
+}
+
+void TestAggregate::test_case5() //group by string key with NULL keys
+{
+   Transaction t;
+
+   QueryResult res = t.execQuery(selectQuery);
+
+   ColumnBatch batch;
+
+   Aggregate::GroupBy<QString> groupBy;
+
+   while (res.fetchColumns(batch, 128) > 0)
+   {
+      groupBy.add(batch.column(0), batch.column(2));
+   }
+
+   QCOMPARE(groupBy.groups().count(), 5);
+
+   const int count = t.each("SELECT k, COUNT(v), SUM(v), MIN(v), MAX(v) FROM aggTable GROUP BY k", [&groupBy](const QueryResult &row)
+   {
+      const Aggregate::Stats stats = row.value(0).isNull()
+            ? groupBy.nullGroup()
+            : groupBy.groups().value(row.value(0).toString());
+
+      QCOMPARE(stats.count(), row.value(1).toLongLong());
+      QCOMPARE(stats.sum(), row.value(2).toDouble());
+      QCOMPARE(stats.min(), row.value(3).toDouble());
+      QCOMPARE(stats.max(), row.value(4).toDouble());
+   });
+
+   QCOMPARE(count, 6);
+}
+
+void TestAggregate::test_case6() //batches of mixed column types in one accumulator
+{
+   Transaction t;
+
+   //SQLite dynamic typing: a text value switches the INTEGER column to ColumnBatch::Variant
+   t.execNonQuery("CREATE TEMP TABLE mixedTable (i INTEGER, r REAL)");
+   t.execNonQuery("INSERT INTO mixedTable VALUES (1, 1.0), (5, 2.5), ('text', 5.0)");
+
+   const ColumnBatch intBatch = t.execQuery("SELECT i FROM mixedTable WHERE rowid <= 2 ORDER BY rowid").fetchColumns(10);
+   const ColumnBatch variantBatch = t.execQuery("SELECT i FROM mixedTable ORDER BY rowid").fetchColumns(10);
+   const ColumnBatch doubleBatch = t.execQuery("SELECT r FROM mixedTable ORDER BY rowid").fetchColumns(10);
+
+   QCOMPARE(intBatch.column(0).type(), ColumnBatch::Int64);
+   QCOMPARE(variantBatch.column(0).type(), ColumnBatch::Variant);
+   QCOMPARE(doubleBatch.column(0).type(), ColumnBatch::Double);
+
+   Aggregate::CountDistinct distinct;
+
+   distinct.add(intBatch.column(0));
+   distinct.add(variantBatch.column(0));
+   distinct.add(doubleBatch.column(0));
+
+   //1, 5, 'text', 2.5
+   QCOMPARE(distinct.count(), 4LL);
+
+   //2.5 is not truncated to the integer key 2
+   Aggregate::GroupBy<qint64> groupBy;
+
+   groupBy.add(doubleBatch.column(0), doubleBatch.column(0));
+
+   QCOMPARE(groupBy.groups().count(), 2);
+   QCOMPARE(groupBy.groups().value(5).sum(), 5.0);
+   QVERIFY(!groupBy.groups().contains(2));
+   QCOMPARE(groupBy.invalidKeyGroup().rowCount(), 1LL);
+   QCOMPARE(groupBy.invalidKeyGroup().sum(), 2.5);
+
+   //text keys of a variant batch
+   Aggregate::GroupBy<qint64> variantGroupBy;
+
+   variantGroupBy.add(variantBatch.column(0), variantBatch.column(0));
+
+   QCOMPARE(variantGroupBy.groups().count(), 2);
+   QCOMPARE(variantGroupBy.invalidKeyGroup().rowCount(), 1LL);
+}
+
+void TestAggregate::benchmark_stats() //kernels over columnar batches vs Util::each + QVariant loop
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int benchRowCount = 1000000;
+   const int batchSize = 10000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x * 0.5 AS v, CASE WHEN x % 10 = 0 THEN NULL ELSE x END AS n FROM cnt").arg(benchRowCount);
+
+   QElapsedTimer timer;
+
+   double sum1 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      double minValue = 0, maxValue = 0;
+      qint64 count = 0;
+
+      timer.start();
+
+      Util::each(res, [&sum1, &minValue, &maxValue, &count](const QueryResult &row)
+      {
+         const QVariant v = row.value(0);
+         const QVariant n = row.value(1);
+
+         if (count == 0)
+         {
+            minValue = maxValue = v.toDouble();
+         }
+
+         sum1 += v.toDouble();
+         minValue = qMin(minValue, v.toDouble());
+         maxValue = qMax(maxValue, v.toDouble());
+         ++count;
+
+         if (!n.isNull())
+            sum1 += n.toDouble();
+      });
+
+      qDebug() << "rows:" << benchRowCount << "Util::each + QVariant ms:" << timer.elapsed();
+   }
+
+   double sum2 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      ColumnBatch batch;
+      Aggregate::Stats v, n;
+
+      timer.restart();
+
+      while (res.fetchColumns(batch, batchSize) > 0)
+      {
+         v.add(batch.column(0));
+         n.add(batch.column(1));
+      }
+
+      sum2 = v.sum() + n.sum();
+
+      qDebug() << "rows:" << benchRowCount << "fetchColumns + Aggregate::Stats ms:" << timer.elapsed();
+   }
+
+   //kernels alone over the same fetched column
+   {
+      QueryResult res = t.execQuery(sql);
+
+      const ColumnBatch batch = res.fetchColumns(benchRowCount);
+
+      QBENCHMARK
+      {
+         Aggregate::Stats v;
+         v.add(batch.column(0));
+      }
+   }
+
+   QCOMPARE(sum2, sum1);
+}
+
+void TestAggregate::benchmark_groupBy() //hash group-by over columnar batches vs Util::each + QVariant loop
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int benchRowCount = 1000000;
+   const int batchSize = 10000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x % 100 AS g, x * 0.5 AS v FROM cnt").arg(benchRowCount);
+
+   QElapsedTimer timer;
+
+   QHash<qint64, double> sums1;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.start();
+
+      Util::each(res, [&sums1](const QueryResult &row)
+      {
+         sums1[row.value(0).toLongLong()] += row.value(1).toDouble();
+      });
+
+      qDebug() << "rows:" << benchRowCount << "Util::each + QHash ms:" << timer.elapsed();
+   }
+
+   Aggregate::GroupBy<qint64> groupBy;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      ColumnBatch batch;
+
+      timer.restart();
+
+      while (res.fetchColumns(batch, batchSize) > 0)
+      {
+         groupBy.add(batch.column(0), batch.column(1));
+      }
+
+      qDebug() << "rows:" << benchRowCount << "fetchColumns + Aggregate::GroupBy ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(groupBy.groups().count(), sums1.count());
+
+   for (auto it = sums1.constBegin(); it != sums1.constEnd(); ++it)
+   {
+      QCOMPARE(groupBy.groups().value(it.key()).sum(), it.value());
+   }
+}
+
+QTEST_APPLESS_MAIN(TestAggregate)
+
+#include "tst_testaggregate.moc"
@@ -117,7 +117,9 @@ void TestDelete::test_case1()
          }
       }
 
-      t.deleteFrom("testTable").exec();
+      NonQueryResult deleted = t.deleteFrom("testTable").exec();
+
+      QCOMPARE(deleted.lastQuery(), QString("DELETE FROM testTable"));
 
       {
          QueryResult res = t.execQuery("SELECT COUNT (*) FROM testTable");
@@ -0,0 +1,1357 @@
+#include <QtTest>
+#include "EasyQtSql.h"
+#include "../Shared/Benchmark.h"
+
+using namespace EasyQtSql;
+
+class TestFactory : public QObject
+{
+   Q_OBJECT
+
+public:
+   TestFactory(){}
+   ~TestFactory(){}
+
+private slots:
+   void initTestCase();
+   void test_case1();
+   void test_case2();
+   void test_case3();
+   void test_case4();
+   void test_case5();
+   void test_case6();
+   void test_case7();
+   void test_case8();
+   void test_case9();
+   void test_case10();
+   void test_case11();
+   void test_case12();
+   void test_case13();
+   void test_case14();
+   void test_case15();
+   void test_case16();
+   void test_case17();
+   void test_case18();
+   void test_case19();
+   void test_case20();
+   void test_case21();
+   void test_case22();
+   void test_case23();
+   void test_case24();
+   void test_case25();
+   void test_case26();
+   void test_case27();
+   void test_case28();
+   void test_case29();
+   void test_case30();
+   void test_case31();
+   void benchmark_getDatabase();
+   void benchmark_warmup();
+   void benchmark_prefetch();
+
+};
+
+//====================================================
+// Runs function object in QThreadPool thread
+
+template<typename Func>
+class Task : public QRunnable
+{
+public:
+   explicit Task(Func f)
+      : m_f(f)
+   { }
+
+   void run() override
+   {
+      m_f();
+   }
+
+private:
+   Func m_f;
+};
+
+template<typename Func>
+Task<Func> *task(Func f)
+{
+   return new Task<Func>(f);
+}
+
+//====================================================
+
+void TestFactory::initTestCase()
+{
+   QLatin1Literal driverName("QSQLITE");
+
+   if (!QSqlDatabase::drivers().contains(driverName))
+       QFAIL("This test requires the SQLITE database driver");
+}
+
+void TestFactory::test_case1() //pooled connections are reused
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 2), "pool1");
+
+   QSharedPointer<SqlFactory::ConnectionPool> pool = factory->connectionPool("pool1");
+
+   QVERIFY(!pool.isNull());
+
+   QString firstConnectionName;
+
+   {
+      SqlFactory::PooledConnection c1 = factory->acquire("pool1");
+      SqlFactory::PooledConnection c2 = factory->acquire("pool1");
+
+      QVERIFY(c1.isValid());
+      QVERIFY(c2.isValid());
+      QVERIFY(c1.database().connectionName() != c2.database().connectionName());
+
+      QCOMPARE(pool->openCount(), 2);
+      QCOMPARE(pool->idleCount(), 0);
+
+      firstConnectionName = c1.database().connectionName();
+
+      Database sdb(c1.database());
+
+      QCOMPARE(sdb.scalar<int>("SELECT 1"), 1);
+   }
+
+   QCOMPARE(pool->openCount(), 2);
+   QCOMPARE(pool->idleCount(), 2);
+
+   SqlFactory::PooledConnection c3 = factory->acquire("pool1");
+
+   QVERIFY(c3.isValid());
+   QCOMPARE(pool->openCount(), 2); //no new connection opened
+   QCOMPARE(pool->idleCount(), 1);
+}
+
+void TestFactory::test_case2() //exhausted pool: wait timeout
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 1).setPoolWaitTimeout(50), "pool2");
+
+   SqlFactory::PooledConnection c1 = factory->acquire("pool2");
+
+   QVERIFY(c1.isValid());
+
+   QElapsedTimer timer;
+   timer.start();
+
+   QVERIFY_EXCEPTION_THROWN(factory->acquire("pool2"), DBException);
+
+   QVERIFY(timer.elapsed() >= 50);
+
+   c1.release();
+
+   SqlFactory::PooledConnection c2 = factory->acquire("pool2");
+
+   QVERIFY(c2.isValid());
+}
+
+void TestFactory::test_case3() //exhausted pool: wait queue
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 1), "pool3");
+
+   SqlFactory::PooledConnection *c1 = new SqlFactory::PooledConnection(factory->acquire("pool3"));
+
+   QThreadPool threadPool;
+
+   threadPool.start(task([c1]()
+   {
+      QThread::msleep(100);
+
+      delete c1; //returns connection to the pool
+   }));
+
+   QElapsedTimer timer;
+   timer.start();
+
+   SqlFactory::PooledConnection c2 = factory->acquire("pool3", 5000);
+
+   QVERIFY(c2.isValid());
+   QVERIFY(timer.elapsed() < 5000);
+
+   threadPool.waitForDone();
+}
+
+void TestFactory::test_case4() //idle eviction
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(1, 4).setPoolMaxIdleTime(10), "pool4");
+
+   QSharedPointer<SqlFactory::ConnectionPool> pool = factory->connectionPool("pool4");
+
+   {
+      SqlFactory::PooledConnection c1 = factory->acquire("pool4");
+      SqlFactory::PooledConnection c2 = factory->acquire("pool4");
+      SqlFactory::PooledConnection c3 = factory->acquire("pool4");
+   }
+
+   QCOMPARE(pool->openCount(), 3);
+
+   QThread::msleep(50);
+
+   factory->evictIdleConnections();
+
+   QCOMPARE(pool->openCount(), 1); //min pool size
+   QCOMPARE(pool->idleCount(), 1);
+}
+
+void TestFactory::test_case5() //pool size is bounded for many threads
+{
+   const int maxPoolSize = 4;
+
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, maxPoolSize), "pool5");
+
+   QSharedPointer<SqlFactory::ConnectionPool> pool = factory->connectionPool("pool5");
+
+   QAtomicInt queries;
+   QAtomicInt errors;
+   QAtomicInt maxOpenCount;
+
+   QThreadPool threadPool;
+   threadPool.setMaxThreadCount(16);
+
+   for (int i = 0; i < 64; ++i)
+   {
+      threadPool.start(task([factory, pool, &queries, &errors, &maxOpenCount]()
+      {
+         try
+         {
+            for (int j = 0; j < 20; ++j)
+            {
+               SqlFactory::PooledConnection conn = factory->acquire("pool5");
+
+               const int openCount = pool->openCount();
+
+               int currentMax = maxOpenCount.load();
+               while (openCount > currentMax && !maxOpenCount.testAndSetOrdered(currentMax, openCount))
+               {
+                  currentMax = maxOpenCount.load();
+               }
+
+               Database sdb(conn.database());
+
+               if (sdb.scalar<int>("SELECT 1") == 1)
+               {
+                  queries.ref();
+               }
+            }
+         }
+         catch (const DBException &)
+         {
+            errors.ref();
+         }
+      }));
+   }
+
+   threadPool.waitForDone();
+
+   QCOMPARE(errors.load(), 0);
+   QCOMPARE(queries.load(), 64 * 20);
+   QVERIFY(maxOpenCount.load() <= maxPoolSize);
+   QVERIFY(pool->openCount() <= maxPoolSize);
+}
+
+void TestFactory::test_case6() //thread-local connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "local6");
+
+   const QString mainConnectionName = factory->getDatabase("local6").connectionName();
+
+   QCOMPARE(factory->getDatabase("local6").connectionName(), mainConnectionName); //same connection for the same thread
+   QVERIFY(factory->getDatabase("local6").isOpen());
+   QVERIFY(!factory->getDatabase("notConfigured").isValid());
+
+   QString threadConnectionName;
+
+   QThreadPool threadPool;
+
+   threadPool.start(task([factory, &threadConnectionName]()
+   {
+      threadConnectionName = factory->getDatabase("local6").connectionName();
+   }));
+
+   threadPool.waitForDone();
+
+   QVERIFY(!threadConnectionName.isEmpty());
+   QVERIFY(threadConnectionName != mainConnectionName); //own connection for each thread
+}
+
+void TestFactory::test_case7() //statement cache hits/misses
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setStatementCacheCapacity(2), "cache7");
+
+   try
+   {
+      Database sdb(factory->getDatabase("cache7"));
+
+      sdb.execNonQuery("CREATE TABLE testTable (a int, b int, c int, d text)");
+
+      StatementCache *cache = factory->statementCache("cache7");
+
+      QVERIFY(cache != nullptr);
+      QCOMPARE(cache->capacity(), 2);
+
+      for (int i = 0; i < 3; ++i)
+      {
+         sdb.insertInto("testTable (a, b, c, d)").values(i, i, i, "a").exec();
+      }
+
+      QCOMPARE(cache->misses(), quint64(1));
+      QCOMPARE(cache->hits(), quint64(2));
+
+      for (int i = 0; i < 3; ++i)
+      {
+         PreparedQuery query = sdb.prepare("SELECT COUNT(*) FROM testTable WHERE a >= ?");
+
+         QueryResult res = query.exec(i);
+
+         QVERIFY(res.next());
+         QCOMPARE(res.scalar<int>(), 3 - i);
+      }
+
+      QCOMPARE(cache->misses(), quint64(2));
+      QCOMPARE(cache->hits(), quint64(4));
+      QCOMPARE(cache->size(), 2);
+
+      sdb.update("testTable").set("d", "b").where("a = ?", 1);
+      sdb.deleteFrom("testTable").where("a = ?", 2);
+
+      QCOMPARE(cache->misses(), quint64(4));
+      QCOMPARE(cache->evictions(), quint64(2)); //capacity is 2
+      QCOMPARE(cache->size(), 2);
+
+      QCOMPARE(sdb.scalar<int>("SELECT COUNT(*) FROM testTable"), 2);
+      QCOMPARE(sdb.scalar<QString>("SELECT d FROM testTable WHERE a = 1"), QString("b"));
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case8() //cached statement is not shared by simultaneously used queries
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "cache8");
+
+   try
+   {
+      Database sdb(factory->getDatabase("cache8"));
+
+      sdb.execNonQuery("CREATE TABLE testTable (a int)");
+      sdb.insertInto("testTable (a)").values(1).values(2).values(3).exec();
+
+      StatementCache *cache = factory->statementCache("cache8");
+
+      const QString sql = "SELECT a FROM testTable WHERE a >= ? ORDER BY a";
+
+      PreparedQuery query1 = sdb.prepare(sql);
+      QueryResult res1 = query1.exec(1);
+
+      PreparedQuery query2 = sdb.prepare(sql); //statement of query1 is in use, new one is prepared
+      QueryResult res2 = query2.exec(3);
+
+      QVERIFY(res1.next());
+      QCOMPARE(res1.scalar<int>(), 1);
+      QVERIFY(res2.next());
+      QCOMPARE(res2.scalar<int>(), 3);
+      QVERIFY(res1.next());
+      QCOMPARE(res1.scalar<int>(), 2);
+
+      QCOMPARE(cache->hits(), quint64(0));
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case9() //high-throughput SQLite profile
+{
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteHighThroughput(dir.filePath("tuned.db")), "tuned9");
+
+   QSqlDatabase db = factory->getDatabase("tuned9");
+
+   QVERIFY(db.isOpen());
+   QCOMPARE(db.connectOptions(), QString("QSQLITE_BUSY_TIMEOUT=5000"));
+
+   try
+   {
+      Database sdb(db);
+
+      QCOMPARE(sdb.scalar<QString>("PRAGMA journal_mode"), QString("wal"));
+      QCOMPARE(sdb.scalar<int>("PRAGMA synchronous"), 1);   //NORMAL
+      QCOMPARE(sdb.scalar<int>("PRAGMA cache_size"), -65536);
+      QCOMPARE(sdb.scalar<int>("PRAGMA temp_store"), 2);    //MEMORY
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case10() //init statements of pooled connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .setPoolSize(0, 2)
+                                                           .addInitStatement("CREATE TEMP TABLE initTable (a int)")
+                                                           .addInitStatement("INSERT INTO initTable VALUES (42)"), "init10");
+
+   try
+   {
+      SqlFactory::PooledConnection c1 = factory->acquire("init10");
+      SqlFactory::PooledConnection c2 = factory->acquire("init10");
+
+      QCOMPARE(Database(c1.database()).scalar<int>("SELECT a FROM initTable"), 42);
+      QCOMPARE(Database(c2.database()).scalar<int>("SELECT a FROM initTable"), 42);
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+
+   //failed init statement fails the checkout
+   factory->config(SqlFactory::DBSetting::sqliteInmemory()
+                   .setPoolSize(0, 2)
+                   .addInitStatement("SELECT * FROM noSuchTable"), "init10");
+
+   QVERIFY_EXCEPTION_THROWN(factory->acquire("init10"), DBException);
+}
+
+void TestFactory::test_case11() //synchronous warm-up of pooled connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 4).setWarmup(3), "warmup11");
+
+   QSharedPointer<SqlFactory::ConnectionPool> pool = factory->connectionPool("warmup11");
+
+   QCOMPARE(pool->openCount(), 3);
+   QCOMPARE(pool->idleCount(), 3);
+
+   {
+      SqlFactory::PooledConnection conn = factory->acquire("warmup11");
+
+      QVERIFY(conn.database().isOpen());
+      QCOMPARE(pool->openCount(), 3); //warm connection is used, no new one is opened
+   }
+
+   //warm-up is bounded by the max pool size
+   factory->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 2).setWarmup(10), "warmup11");
+
+   QCOMPARE(factory->connectionPool("warmup11")->openCount(), 2);
+}
+
+void TestFactory::test_case12() //background warm-up of pooled connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 4).setWarmup(4, true), "warmup12");
+
+   QSharedPointer<SqlFactory::ConnectionPool> pool = factory->connectionPool("warmup12");
+
+   QElapsedTimer timer;
+   timer.start();
+
+   while (pool->idleCount() < 4 && !timer.hasExpired(5000))
+   {
+      QThread::msleep(10);
+   }
+
+   QCOMPARE(pool->idleCount(), 4);
+   QCOMPARE(pool->openCount(), 4);
+}
+
+void TestFactory::test_case13() //warm-up of thread-local connections (QSQLITE connections are not handed over to other threads)
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .addInitStatement("CREATE TEMP TABLE warmTable (a int)")
+                                                           .setWarmup(2), "warmup13");
+
+   QCOMPARE(factory->metrics().connection("warmup13").opens, quint64(0)); //QSQLITE connections are opened by their own threads
+
+   QAtomicInt errors;
+
+   QThreadPool threadPool;
+   threadPool.setMaxThreadCount(4);
+
+   for (int i = 0; i < 4; ++i)
+   {
+      threadPool.start(task([factory, &errors]()
+      {
+         try
+         {
+            Database sdb(factory->getDatabase("warmup13"));
+
+            sdb.execNonQuery("INSERT INTO warmTable VALUES (1)"); //init statements were executed on warm and new connections
+         }
+         catch (const DBException &)
+         {
+            errors.ref();
+         }
+      }));
+   }
+
+   threadPool.waitForDone();
+
+   QCOMPARE(errors.load(), 0);
+
+   QVERIFY(!SqlFactory::isCrossThreadDriver("QSQLITE"));
+   QVERIFY(SqlFactory::isCrossThreadDriver("QPSQL"));
+}
+
+void TestFactory::test_case14() //max uses of pooled connection
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 1).setMaxUses(2), "uses14");
+
+   QStringList names;
+
+   for (int i = 0; i < 3; ++i)
+   {
+      SqlFactory::PooledConnection conn = factory->acquire("uses14");
+
+      names << conn.database().connectionName();
+   }
+
+   QCOMPARE(names.at(0), names.at(1));
+   QVERIFY(names.at(1) != names.at(2)); //recycled after the second use
+}
+
+void TestFactory::test_case15() //max lifetime of pooled connection
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 1).setMaxLifetime(50), "lifetime15");
+
+   QString firstName;
+
+   {
+      SqlFactory::PooledConnection conn = factory->acquire("lifetime15");
+
+      firstName = conn.database().connectionName();
+   }
+
+   QThread::msleep(100);
+
+   SqlFactory::PooledConnection conn = factory->acquire("lifetime15");
+
+   QVERIFY(conn.database().connectionName() != firstName);
+   QCOMPARE(factory->connectionPool("lifetime15")->openCount(), 1);
+}
+
+void TestFactory::test_case16() //broken thread-local connection is detected by the validation query and reopened
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .addInitStatement("CREATE TEMP TABLE healthTable (a int)")
+                                                           .setValidationQuery("SELECT count(*) FROM healthTable")
+                                                           .setValidationInterval(0), "health16");
+
+   try
+   {
+      Database(factory->getDatabase("health16")).execNonQuery("INSERT INTO healthTable VALUES (1)");
+
+      QCOMPARE(Database(factory->getDatabase("health16")).scalar<int>("SELECT count(*) FROM healthTable"), 1); //validation passed, same connection
+
+      Database(factory->getDatabase("health16")).execNonQuery("DROP TABLE healthTable"); //validation query fails from now on
+
+      //connection is reopened and initialized again
+      QCOMPARE(Database(factory->getDatabase("health16")).scalar<int>("SELECT count(*) FROM healthTable"), 0);
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case17() //reconnect with backoff
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .setPoolSize(0, 1)
+                                                           .addInitStatement("SELECT * FROM noSuchTable")
+                                                           .setReconnectBackoff(20, 40, 3), "backoff17");
+
+   QElapsedTimer timer;
+   timer.start();
+
+   QVERIFY_EXCEPTION_THROWN(factory->acquire("backoff17"), DBException);
+
+   QVERIFY(timer.elapsed() >= 20 + 40); //three attempts, two delays
+   QCOMPARE(factory->connectionPool("backoff17")->openCount(), 0);
+}
+
+void TestFactory::test_case18() //idle connections of parked threads are reaped
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .addInitStatement("CREATE TEMP TABLE reapTable (a int)"), "reap18");
+
+   QThreadPool threadPool;
+   threadPool.setMaxThreadCount(1);
+   threadPool.setExpiryTimeout(-1); //the same thread runs all the tasks
+
+   int count = -1;
+   bool isOpen = false;
+
+   threadPool.start(task([factory]()
+   {
+      Database(factory->getDatabase("reap18")).execNonQuery("INSERT INTO reapTable VALUES (1)");
+   }));
+
+   threadPool.waitForDone();
+
+   QCOMPARE(factory->reapIdleConnections(60000), 0); //used recently
+
+   QThread::msleep(50);
+
+   QVERIFY(factory->reapIdleConnections(20) >= 1);
+
+   threadPool.start(task([factory, &count, &isOpen]()
+   {
+      QSqlDatabase db = factory->getDatabase("reap18");
+
+      isOpen = db.isOpen();
+      count = Database(db).scalar<int>("SELECT count(*) FROM reapTable");
+   }));
+
+   threadPool.waitForDone();
+
+   QVERIFY(isOpen);   //reopened by the owner thread
+   QCOMPARE(count, 0); //new in-memory database
+}
+
+void TestFactory::test_case19() //releaseThreadConnections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "release19");
+
+   const QString connectionName = factory->getDatabase("release19").connectionName();
+
+   QVERIFY(QSqlDatabase::contains(connectionName));
+
+   factory->releaseThreadConnections();
+
+   QVERIFY(!QSqlDatabase::contains(connectionName));
+   QVERIFY(factory->statementCache("release19") == nullptr);
+
+   QSqlDatabase db = factory->getDatabase("release19");
+
+   QVERIFY(db.isOpen());
+   QVERIFY(db.connectionName() != connectionName);
+}
+
+//====================================================
+// SQLite files standing in for a primary and its replicas, each one reports its own name
+
+static SqlFactory::DBSetting replicaSetting(const QTemporaryDir &dir, const QString &name)
+{
+   return SqlFactory::DBSetting("QSQLITE", dir.filePath(name + ".db"))
+         .addInitStatement(QString("CREATE TEMP VIEW origin AS SELECT '%1' AS name").arg(name));
+}
+
+static SqlFactory *configReplicaGroup(const QTemporaryDir &dir, const QString &connectionName, SqlFactory::ReplicaPolicy policy)
+{
+   return SqlFactory::getInstance()
+         ->config(replicaSetting(dir, "primary"), connectionName)
+         ->configReplicas({ replicaSetting(dir, "replica0"), replicaSetting(dir, "replica1") }, connectionName, policy);
+}
+
+//====================================================
+
+void TestFactory::test_case20() //reads go to replicas round robin, writes and transactions stay on primary
+{
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   SqlFactory *factory = configReplicaGroup(dir, "rw20", SqlFactory::RoundRobin);
+
+   try
+   {
+      Database sdb(factory->getDatabase("rw20"));
+
+      QStringList origins;
+
+      for (int i = 0; i < 4; ++i)
+      {
+         origins << sdb.scalar<QString>("SELECT name FROM origin");
+      }
+
+      QCOMPARE(origins.count("replica0"), 2);
+      QCOMPARE(origins.count("replica1"), 2);
+
+      sdb.execNonQuery("CREATE TABLE written (a int)");
+
+      sdb.insertInto("written (a)").values(1).exec();
+
+      Transaction t(factory->getDatabase("rw20"));
+
+      QCOMPARE(t.scalar<QString>("SELECT name FROM origin"), QString("primary"));
+      QCOMPARE(t.scalar<int>("SELECT count(*) FROM written"), 1);
+
+      t.commit();
+
+      //routing is disabled with an empty replica list
+      factory->configReplicas(QList<SqlFactory::DBSetting>(), "rw20");
+
+      QCOMPARE(sdb.scalar<QString>("SELECT name FROM origin"), QString("primary"));
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case21() //read-your-writes scope
+{
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   SqlFactory *factory = configReplicaGroup(dir, "rw21", SqlFactory::RoundRobin);
+
+   try
+   {
+      Database sdb(factory->getDatabase("rw21"));
+
+      {
+         SqlFactory::ReadYourWrites scope;
+
+         QVERIFY(sdb.scalar<QString>("SELECT name FROM origin") != "primary"); //no writes yet
+
+         sdb.execNonQuery("CREATE TABLE IF NOT EXISTS written (a int)");
+
+         for (int i = 0; i < 4; ++i)
+         {
+            QCOMPARE(sdb.scalar<QString>("SELECT name FROM origin"), QString("primary"));
+         }
+      }
+
+      QVERIFY(sdb.scalar<QString>("SELECT name FROM origin") != "primary"); //the scope has ended
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case22() //least outstanding requests
+{
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   SqlFactory *factory = configReplicaGroup(dir, "rw22", SqlFactory::LeastOutstanding);
+
+   try
+   {
+      Database sdb(factory->getDatabase("rw22"));
+
+      QueryResult busy = sdb.execQuery("SELECT name FROM origin"); //keeps its replica busy
+
+      QVERIFY(busy.next());
+
+      const QString busyReplica = busy.value(0).toString();
+
+      for (int i = 0; i < 4; ++i)
+      {
+         const QString origin = sdb.scalar<QString>("SELECT name FROM origin");
+
+         QVERIFY(origin != busyReplica);
+         QVERIFY(origin != "primary");
+      }
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case23() //pool metrics
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(0, 2), "metrics23");
+
+   {
+      SqlFactory::PooledConnection c1 = factory->acquire("metrics23");
+      SqlFactory::PooledConnection c2 = factory->acquire("metrics23");
+
+      QVERIFY_EXCEPTION_THROWN(factory->acquire("metrics23", 10), DBException);
+
+      const MetricsSnapshot::Connection m = factory->metrics().connection("metrics23");
+
+      QVERIFY(m.pooled);
+      QCOMPARE(m.open, 2);
+      QCOMPARE(m.idle, 0);
+      QCOMPARE(m.inUse, 2);
+      QCOMPARE(m.opens, quint64(2));
+      QCOMPARE(m.openFailures, quint64(0));
+      QCOMPARE(m.checkouts, quint64(2));
+      QCOMPARE(m.checkoutTimeouts, quint64(1));
+      QCOMPARE(m.checkoutWait.count, quint64(3));
+      QCOMPARE(m.openLatency.count, quint64(2));
+   }
+
+   const MetricsSnapshot snapshot = factory->metrics();
+
+   QCOMPARE(snapshot.connection("metrics23").idle, 2);
+   QCOMPARE(snapshot.connection("metrics23").inUse, 0);
+
+   //JSON snapshot
+   const QJsonObject json = QJsonDocument::fromJson(snapshot.toJson()).object()["connections"].toObject()["metrics23"].toObject();
+
+   QCOMPARE(json["idle"].toInt(), 2);
+   QCOMPARE(json["checkoutTimeouts"].toInt(), 1);
+   QCOMPARE(json["checkoutWaitUs"].toObject()["count"].toInt(), 3);
+
+   //Prometheus text
+   const QByteArray text = snapshot.toPrometheus();
+
+   QVERIFY(text.contains("# TYPE easyqtsql_pool_checkout_wait_seconds histogram"));
+   QVERIFY(text.contains("easyqtsql_pool_checkouts_total{connection=\"metrics23\"} 2\n"));
+   QVERIFY(text.contains("easyqtsql_pool_checkout_wait_seconds_bucket{connection=\"metrics23\",le=\"+Inf\"} 3\n"));
+
+   //open failures
+   factory->config(SqlFactory::DBSetting::sqliteInmemory()
+                   .setPoolSize(0, 1)
+                   .addInitStatement("SELECT * FROM noSuchTable"), "metrics23f");
+
+   QVERIFY_EXCEPTION_THROWN(factory->acquire("metrics23f"), DBException);
+
+   QCOMPARE(factory->metrics().connection("metrics23f").openFailures, quint64(1));
+}
+
+void TestFactory::test_case24() //statement cache hit rate, export to file and callback
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "metrics24");
+
+   try
+   {
+      Database sdb(factory->getDatabase("metrics24"));
+
+      for (int i = 0; i < 4; ++i)
+      {
+         sdb.prepare("SELECT 1").exec();
+      }
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+
+   const MetricsSnapshot::Connection m = factory->metrics().connection("metrics24");
+
+   QCOMPARE(m.cacheMisses, quint64(1));
+   QCOMPARE(m.cacheHits, quint64(3));
+   QCOMPARE(m.cacheHitRate(), 0.75);
+   QVERIFY(m.threadLocal >= 1);
+
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   const QString fileName = dir.filePath("easyqtsql.prom");
+
+   QVERIFY(factory->exportMetrics(fileName));
+
+   QFile file(fileName);
+
+   QVERIFY(file.open(QIODevice::ReadOnly));
+   QVERIFY(file.readAll().contains("easyqtsql_statement_cache_hits_total{connection=\"metrics24\"} 3\n"));
+
+   QByteArray exported;
+
+   factory->exportMetrics([&exported](const QByteArray &data) { exported = data; });
+
+   QCOMPARE(QJsonDocument::fromJson(exported).object()["connections"].toObject()["metrics24"].toObject()["statementCache"].toObject()["hits"].toInt(), 3);
+}
+
+void TestFactory::test_case25() //shared in-memory database is visible to all threads and outlives their connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteSharedInmemory("shared25"), "shared25");
+
+   bool created = false;
+
+   {
+      QThreadPool threadPool;
+
+      threadPool.start(task([factory, &created]()
+      {
+         try
+         {
+            Database sdb(factory->getDatabase("shared25"));
+
+            sdb.execNonQuery("CREATE TABLE sharedTable (a int)");
+            sdb.insertInto("sharedTable (a)").values(1).values(2).exec();
+
+            created = true;
+         }
+         catch (const DBException &)
+         { }
+      }));
+
+      threadPool.waitForDone();
+   } //the thread and its connection are gone
+
+   QVERIFY(created);
+
+   try
+   {
+      Database sdb(factory->getDatabase("shared25"));
+
+      QCOMPARE(sdb.scalar<int>("SELECT count(*) FROM sharedTable"), 2);
+
+      //private in-memory databases are not shared
+      factory->config(SqlFactory::DBSetting::sqliteSharedInmemory("other25"), "other25");
+
+      QVERIFY_EXCEPTION_THROWN(Database(factory->getDatabase("other25")).scalar<int>("SELECT count(*) FROM sharedTable"), DBException);
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestFactory::test_case26() //single writer, multiple readers
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteSharedInmemory("shared26"), "shared26");
+
+   try
+   {
+      Database(factory->getDatabase("shared26")).execNonQuery("CREATE TABLE sharedTable (writer int, a int)");
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+
+   const int writers = 4;
+   const int readers = 4;
+   const int rowsPerWriter = 200;
+
+   QAtomicInt errors;
+   QAtomicInt reads;
+   QAtomicInt writersDone;
+
+   QThreadPool threadPool;
+   threadPool.setMaxThreadCount(writers + readers);
+
+   for (int w = 0; w < writers; ++w)
+   {
+      threadPool.start(task([factory, w, rowsPerWriter, &errors, &writersDone]()
+      {
+         try
+         {
+            for (int i = 0; i < rowsPerWriter; i += 20)
+            {
+               Transaction t(factory->getDatabase("shared26"));
+
+               InsertQuery insert = t.insertInto("sharedTable (writer, a)");
+
+               for (int j = 0; j < 20; ++j)
+               {
+                  insert.values(w, i + j);
+               }
+
+               insert.exec();
+
+               t.commit();
+            }
+         }
+         catch (const DBException &)
+         {
+            errors.ref();
+         }
+
+         writersDone.ref();
+      }));
+   }
+
+   for (int r = 0; r < readers; ++r)
+   {
+      threadPool.start(task([factory, writers, &errors, &reads, &writersDone]()
+      {
+         try
+         {
+            Database sdb(factory->getDatabase("shared26"));
+
+            while (writersDone.load() < writers)
+            {
+               sdb.scalar<int>("SELECT count(*) FROM sharedTable");
+
+               reads.ref();
+            }
+         }
+         catch (const DBException &)
+         {
+            errors.ref();
+         }
+      }));
+   }
+
+   threadPool.waitForDone();
+
+   QCOMPARE(errors.load(), 0);
+   QVERIFY(reads.load() > 0);
+
+   try
+   {
+      QCOMPARE(Database(factory->getDatabase("shared26")).scalar<int>("SELECT count(*) FROM sharedTable"), writers * rowsPerWriter);
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+static QString countQuery(int rowCount, int producerCost = 0)
+{
+   //producerCost > 0 adds a scalar subquery of producerCost iterations per row (slow producer)
+   const QString payload = producerCost > 0
+         ? QString("(WITH RECURSIVE c(y) AS (SELECT x UNION ALL SELECT y + 1 FROM c LIMIT %0) SELECT SUM(y) FROM c)").arg(producerCost)
+         : QString("x * 2");
+
+   return QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                  "SELECT x AS a, %1 AS b, 'row' || x AS c FROM cnt").arg(rowCount).arg(payload);
+}
+
+void TestFactory::test_case27() //prefetched rows across batches
+{
+   SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "prefetch27");
+
+   const int rowCount = 1000;
+
+   PrefetchResult res(countQuery(rowCount) + " WHERE x > ?", {10}, "prefetch27", 7, 3);
+
+   int row = 11;
+
+   while (res.next())
+   {
+      QCOMPARE(res.value(0).toInt(), row);
+      QCOMPARE(res.value("B").toInt(), row * 2);
+      QCOMPARE(res.get<QString>(2), QString("row%0").arg(row));
+
+      const auto tuple = res.get<int, qint64>();
+      QCOMPARE(std::get<1>(tuple), qint64(row * 2));
+
+      ++row;
+   }
+
+   QCOMPARE(row, rowCount + 1);
+   QCOMPARE(res.fieldNames(), QStringList({"a", "b", "c"}));
+   QVERIFY(!res.lastError().isValid());
+   QVERIFY(!res.next());
+}
+
+void TestFactory::test_case28() //prefetch errors
+{
+   SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "prefetch28");
+
+   {
+      PrefetchResult res("SELECT * FROM noSuchTable", QVariantList(), "prefetch28");
+
+      QVERIFY_EXCEPTION_THROWN(res.next(), DBException);
+      QVERIFY(res.lastError().isValid());
+   }
+
+   {
+      PrefetchResult res("SELECT 1", QVariantList(), "notConfigured28");
+
+      QVERIFY_EXCEPTION_THROWN(res.next(), DBException);
+      QCOMPARE(res.lastError().type(), QSqlError::ConnectionError);
+   }
+}
+
+void TestFactory::test_case29() //abandoned prefetch stops the producer
+{
+   SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "prefetch29");
+
+   QElapsedTimer timer;
+   timer.start();
+
+   {
+      PrefetchResult res(countQuery(100000000), QVariantList(), "prefetch29", 100, 2);
+
+      QVERIFY(res.next());
+      QCOMPARE(res.value(0).toInt(), 1);
+
+      //the producer is blocked by the full buffer now, the destructor cancels it
+   }
+
+   QVERIFY(timer.elapsed() < 10000);
+}
+
+void TestFactory::test_case30() //leased connections are not reaped, expired ones are closed by the owner thread
+{
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory()
+                                                           .addInitStatement("CREATE TEMP TABLE leaseTable (a int)"), "lease30");
+
+   QSqlDatabase db = factory->getDatabase("lease30");
+
+   {
+      Database sdb(db);
+
+      sdb.execNonQuery("INSERT INTO leaseTable VALUES (1)");
+
+      QThread::msleep(50);
+
+      factory->reapIdleConnections(20);
+
+      QCoreApplication::sendPostedEvents();
+
+      QVERIFY(db.isOpen()); //leased by sdb
+      QCOMPARE(sdb.scalar<int>("SELECT count(*) FROM leaseTable"), 1);
+   }
+
+   QThread::msleep(50);
+
+   QVERIFY(factory->reapIdleConnections(20) >= 1);
+   QVERIFY(db.isOpen()); //the reaper thread does not close connections
+
+   QCoreApplication::sendPostedEvents(); //queued close runs in the owner thread
+
+   QVERIFY(!db.isOpen());
+   QVERIFY(factory->getDatabase("lease30").isOpen());
+}
+
+void TestFactory::test_case31() //shutdown closes pooled, keep-alive and current thread connections
+{
+   SqlFactory *factory = SqlFactory::getInstance()
+         ->config(SqlFactory::DBSetting::sqliteInmemory().setPoolSize(1, 2), "shutdown31")
+         ->config(SqlFactory::DBSetting::sqliteSharedInmemory("shutdown31"), "shared31");
+
+   QString pooledName;
+   {
+      SqlFactory::PooledConnection conn = factory->acquire("shutdown31");
+
+      pooledName = conn.database().connectionName();
+   }
+
+   const QString threadName = factory->getDatabase("shared31").connectionName();
+
+   QVERIFY(QSqlDatabase::contains(pooledName));
+   QVERIFY(QSqlDatabase::contains(threadName));
+
+   factory->shutdown();
+
+   QVERIFY(!QSqlDatabase::contains(pooledName));
+   QVERIFY(!QSqlDatabase::contains(threadName));
+   QVERIFY(factory->connectionPool("shutdown31").isNull());
+
+   QVERIFY(factory->getDatabase("shared31").isOpen()); //settings stay configured
+}
+
+void TestFactory::benchmark_getDatabase() //getDatabase scaling with thread count
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "bench");
+
+   QBENCHMARK
+   {
+      factory->getDatabase("bench");
+   }
+
+   //the former getDatabase implementation: global mutex + settings map lookup + QSqlDatabase::database() lookup
+   QMutex mutex;
+   const QMap<QString, QString> settings = { {"bench", "bench"} };
+
+   auto lockedGetDatabase = [&mutex, &settings, factory]()
+   {
+      QMutexLocker locker(&mutex);
+
+      if (settings.contains("bench"))
+      {
+         return QSqlDatabase::database(factory->getDatabase("bench").connectionName());
+      }
+
+      return QSqlDatabase();
+   };
+
+   const int callsPerThread = 100000;
+
+   for (int threadCount = 1; threadCount <= QThread::idealThreadCount(); threadCount *= 2)
+   {
+      QThreadPool threadPool;
+      threadPool.setMaxThreadCount(threadCount);
+
+      QElapsedTimer timer;
+
+      //lock-free path
+      timer.start();
+
+      for (int i = 0; i < threadCount; ++i)
+      {
+         threadPool.start(task([factory, callsPerThread]()
+         {
+            for (int j = 0; j < callsPerThread; ++j)
+            {
+               factory->getDatabase("bench");
+            }
+         }));
+      }
+
+      threadPool.waitForDone();
+
+      const qint64 lockFreeTime = timer.elapsed();
+
+      //locked path
+      timer.restart();
+
+      for (int i = 0; i < threadCount; ++i)
+      {
+         threadPool.start(task([lockedGetDatabase, callsPerThread]()
+         {
+            for (int j = 0; j < callsPerThread; ++j)
+            {
+               lockedGetDatabase();
+            }
+         }));
+      }
+
+      threadPool.waitForDone();
+
+      const qint64 lockedTime = timer.elapsed();
+
+      qDebug() << "threads:" << threadCount
+               << "calls:" << threadCount * callsPerThread
+               << "lock-free ms:" << lockFreeTime
+               << "mutex ms:" << lockedTime;
+   }
+}
+
+void TestFactory::benchmark_warmup() //first request latency with and without warm-up
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   QTemporaryDir dir;
+
+   QVERIFY(dir.isValid());
+
+   const SqlFactory::DBSetting setting = SqlFactory::DBSetting::sqliteHighThroughput(dir.filePath("warmup.db"))
+         .addInitStatement("CREATE TABLE IF NOT EXISTS warmTable (a int)");
+
+   SqlFactory *factory = SqlFactory::getInstance();
+
+   auto firstRequest = [factory](const QString &connectionName)
+   {
+      QElapsedTimer timer;
+      timer.start();
+
+      SqlFactory::PooledConnection conn = factory->acquire(connectionName);
+
+      Database(conn.database()).scalar<int>("SELECT count(*) FROM warmTable");
+
+      return timer.nsecsElapsed();
+   };
+
+   const int rounds = 20;
+
+   qint64 coldTime = 0;
+   qint64 warmTime = 0;
+   qint64 configTime = 0;
+
+   for (int i = 0; i < rounds; ++i)
+   {
+      const QString coldName = QString("cold%1").arg(i);
+      const QString warmName = QString("warm%1").arg(i);
+
+      factory->config(SqlFactory::DBSetting(setting).setPoolSize(0, 1), coldName);
+
+      coldTime += firstRequest(coldName);
+
+      QElapsedTimer timer;
+      timer.start();
+
+      factory->config(SqlFactory::DBSetting(setting).setPoolSize(0, 1).setWarmup(1), warmName);
+
+      configTime += timer.nsecsElapsed();
+
+      QCOMPARE(factory->connectionPool(warmName)->openCount(), 1); //opened before the first checkout
+
+      const quint64 opens = factory->metrics().connection(warmName).opens;
+
+      warmTime += firstRequest(warmName);
+
+      QCOMPARE(factory->metrics().connection(warmName).opens, opens); //the checkout uses the warm connection
+   }
+
+   qDebug() << "first request us, cold:" << coldTime / rounds / 1000
+            << "warm:" << warmTime / rounds / 1000
+            << "warm-up in config():" << configTime / rounds / 1000;
+}
+
+void TestFactory::benchmark_prefetch() //synchronous fetch vs prefetch with slow consumer / slow producer
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   SqlFactory *factory = SqlFactory::getInstance()->config(SqlFactory::DBSetting::sqliteInmemory(), "benchPrefetch");
+
+   const int rowCount = 20000;
+
+   auto consume = [](int consumerCost, qint64 value)
+   {
+      //consumerCost iterations of busy work per row (slow consumer)
+      volatile qint64 sink = value;
+
+      for (int i = 0; i < consumerCost; ++i)
+      {
+         sink = sink * 31 + i;
+      }
+
+      return qint64(sink);
+   };
+
+   struct Scenario
+   {
+      const char *name;
+      int producerCost;
+      int consumerCost;
+   };
+
+   const Scenario scenarios[] =
+   {
+      { "slow consumer", 0, 20000 },
+      { "slow producer", 200, 0 },
+      { "balanced", 200, 20000 }
+   };
+
+   for (const Scenario &scenario : scenarios)
+   {
+      const QString sql = countQuery(rowCount, scenario.producerCost);
+
+      QElapsedTimer timer;
+
+      qint64 sum1 = 0;
+      {
+         timer.start();
+
+         QueryResult res = Database(factory->getDatabase("benchPrefetch")).execQuery(sql);
+
+         while (res.next())
+         {
+            sum1 += consume(scenario.consumerCost, res.value(1).toLongLong()) & 1;
+         }
+      }
+
+      const qint64 syncTime = timer.elapsed();
+
+      qint64 sum2 = 0;
+      {
+         timer.restart();
+
+         PrefetchResult res(sql, QVariantList(), "benchPrefetch", 500, 4);
+
+         while (res.next())
+         {
+            sum2 += consume(scenario.consumerCost, res.value(1).toLongLong()) & 1;
+         }
+      }
+
+      const qint64 prefetchTime = timer.elapsed();
+
+      QCOMPARE(sum2, sum1);
+
+      qDebug() << scenario.name
+               << "rows:" << rowCount
+               << "sync rows/s:" << (syncTime > 0 ? rowCount * 1000 / syncTime : 0)
+               << "prefetch rows/s:" << (prefetchTime > 0 ? rowCount * 1000 / prefetchTime : 0);
+   }
+}
+
+QTEST_APPLESS_MAIN(TestFactory)
+
+#include "tst_testfactory.moc"
@@ -9,3 +9,6 @@ CONFIG -= app_bundle
 TEMPLATE = app
 
 SOURCES +=  tst_testinsert.cpp
+
+HEADERS += \
+    ../Shared/Benchmark.h
@@ -1,9 +1,17 @@
 #include <QtTest>
 #include "EasyQtSql.h"
 #include "../Shared/Shared.h"
+#include "../Shared/Benchmark.h"
 
 using namespace  EasyQtSql;
 
+struct PlainRow
+{
+   int a;
+   double weight;
+   QString d;
+};
+
 class TestInsert : public QObject
 {
    Q_OBJECT
@@ -18,6 +26,17 @@ private slots:
    void test_case1();
    void test_case2();
    void test_case3();
+   void test_case4();
+   void test_case5();
+   void test_case6();
+   void test_case7();
+   void test_case8();
+   void test_case9();
+   void benchmark_insert();
+   void benchmark_insertStream();
+   void benchmark_fromGadgets();
+   void benchmark_upsert();
+   void benchmark_insertedIds();
 
 };
 
@@ -208,6 +227,702 @@ void TestInsert::test_case3()
    }, DBException);
 }
 
+void TestInsert::test_case4() //multi-row VALUES chunks
+{
+   const int rowCount = 2500;
+
+   try
+   {
+      Transaction t;
+
+      InsertQuery query = t.insertInto("testTable (a, b, c, d)").setBatchMode(InsertQuery::MultiRowValues);
+
+      QCOMPARE(query.batchMode(), InsertQuery::MultiRowValues);
+
+      //249 rows per chunk for SQLite, the remainder chunk has 10 rows
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values(i, i * 2, i * 3, QString::number(i));
+      }
+
+      NonQueryResult res = query.exec();
+
+      QVERIFY(res.lastQuery().startsWith("INSERT INTO testTable (a, b, c, d) VALUES (?,?,?,?),(?,?,?,?)"));
+
+      //chunk statements are reused, the chunk size is limited
+      query.setBatchMode(InsertQuery::MultiRowValues, 7);
+
+      for (int i = rowCount; i < rowCount + 20; ++i)
+      {
+         query.values(i, i * 2, i * 3, QString::number(i));
+      }
+
+      query.exec();
+
+      //single row is inserted with the single-row statement
+      query.values(rowCount + 20, (rowCount + 20) * 2, (rowCount + 20) * 3, QString::number(rowCount + 20)).exec();
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), rowCount + 21);
+
+      int i = 0;
+
+      t.each("SELECT a, b, c, d FROM testTable ORDER BY a", [&i](const QueryResult &row)
+      {
+         QCOMPARE(row.value(0).toInt(), i);
+         QCOMPARE(row.value(1).toInt(), i * 2);
+         QCOMPARE(row.value(2).toInt(), i * 3);
+         QCOMPARE(row.value(3).toString(), QString::number(i));
+
+         ++i;
+      });
+
+      QCOMPARE(i, rowCount + 21);
+
+      //transaction rolled back
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+
+   QCOMPARE(SqlDialect(SqlDialect::SQLite).maxValuesRows(4), 249);
+   QCOMPARE(SqlDialect(SqlDialect::SqlServer).maxValuesRows(1), 1000);
+   QCOMPARE(SqlDialect(SqlDialect::Oracle).maxValuesRows(4), 1);
+}
+
+void TestInsert::test_case5() //streaming insert with auto flush
+{
+   const int rowCount = 1050;
+
+   try
+   {
+      Transaction t;
+
+      QVector<InsertStream::FlushInfo> flushes;
+
+      InsertStream stream = t.insertStream("testTable (a, b, c, d)", 100);
+
+      stream.onFlush([&flushes](const InsertStream::FlushInfo &info)
+      {
+         flushes.append(info);
+      });
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         stream.values(i, i * 2, i * 3, QString::number(i));
+
+         QVERIFY(stream.pendingRows() < 100);
+      }
+
+      QCOMPARE(stream.flushCount(), 10);
+      QCOMPARE(stream.pendingRows(), 50);
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), 1000);
+
+      QVERIFY(stream.flush());
+
+      QCOMPARE(stream.flushCount(), 11);
+      QCOMPARE(stream.totalRows(), qint64(rowCount));
+      QCOMPARE(flushes.count(), 11);
+      QCOMPARE(flushes.first().rows, 100);
+      QCOMPARE(flushes.last().rows, 50);
+      QCOMPARE(flushes.last().totalRows, qint64(rowCount));
+      QVERIFY(flushes.first().bytes > 0);
+      QVERIFY(stream.totalElapsed() >= 0);
+
+      QCOMPARE(t.scalar<int>("SELECT SUM(c) FROM testTable"), 3 * rowCount * (rowCount - 1) / 2);
+
+      //byte limit: multi-row VALUES flush of about 64 KB
+      InsertStream bytesStream = t.insertStream("testTable (a, b, c, d)", 1000000, 64 * 1024);
+
+      bytesStream.setBatchMode(InsertQuery::MultiRowValues);
+
+      const QString text(1024, QChar('x'));
+
+      for (int i = 0; i < 100; ++i)
+      {
+         bytesStream.values(i, i, i, text);
+      }
+
+      bytesStream.flush();
+
+      QVERIFY(bytesStream.flushCount() > 1);
+      QCOMPARE(bytesStream.totalRows(), qint64(100));
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), rowCount + 100);
+
+      //transaction rolled back
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestInsert::test_case6() //bulk insert from gadgets and plain structs
+{
+   const QVector<Row> rows = { {1, 2, 3, "a"}, {4, 5, 6, "b"}, {7, 8, 9, "c"}, {10, 11, 12, "d"}};
+
+   try
+   {
+      Transaction t;
+
+      //column list derived from the gadget properties
+      InsertQuery query = t.insertInto("testTable");
+
+      query.fromGadgets(rows);
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), rows.count());
+
+      int i = 0;
+
+      t.each("SELECT a, b, c, d FROM testTable ORDER BY a", [&rows, &i](const QueryResult &row)
+      {
+         Row fetched;
+         row.fetchGadget(fetched);
+
+         QCOMPARE(fetched.a, rows[i].a);
+         QCOMPARE(fetched.b, rows[i].b);
+         QCOMPARE(fetched.c, rows[i].c);
+         QCOMPARE(fetched.d, rows[i].d);
+
+         ++i;
+      });
+
+      QCOMPARE(i, rows.count());
+
+      //the cached plan is reused with the derived column list
+      query.fromGadgets(QList<Row>() << rows[0]);
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable WHERE a = 1"), 2);
+
+      //projection on listed columns, multi-row VALUES
+      t.insertInto("testTable (d, a)").setBatchMode(InsertQuery::MultiRowValues).fromGadgets(rows);
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable WHERE b IS NULL"), rows.count());
+
+      //plain structs
+      std::vector<PlainRow> plainRows;
+
+      for (int j = 0; j < 100; ++j)
+      {
+         plainRows.push_back(PlainRow{100 + j, j * 0.5, QString::number(j)});
+      }
+
+      t.insertInto("testTable (a, d)").fromStructs(plainRows, &PlainRow::a, &PlainRow::d);
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable WHERE a >= 100 AND d = CAST(a - 100 AS TEXT)"), 100);
+
+      //empty container
+      t.insertInto("testTable").fromGadgets(QVector<Row>());
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), rows.count() * 2 + 1 + 100);
+
+      //rows queued with values() are inserted before the gadgets and structs
+      t.insertInto("testTable (a, b, c, d)").values(-1, 0, 0, "queued").fromGadgets(rows);
+
+      t.insertInto("testTable (a, d)").values(-2, "queued").fromStructs(plainRows, &PlainRow::a, &PlainRow::d);
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable WHERE d = 'queued'"), 2);
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM testTable"), rows.count() * 3 + 1 + 100 * 2 + 2);
+
+      //transaction rolled back
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+
+   QVERIFY_EXCEPTION_THROWN({
+      Transaction t;
+
+      //no property for column e
+      t.insertInto("testTable (a, e)").fromGadgets(rows);
+   }, DBException);
+
+   QVERIFY_EXCEPTION_THROWN({
+      Transaction t;
+
+      //queued rows do not match the gadget columns
+      t.insertInto("testTable (a, b, c, d)").values(1, 2).fromGadgets(rows);
+   }, DBException);
+}
+
+void TestInsert::test_case7() //upsert
+{
+   try
+   {
+      Transaction t;
+
+      t.execNonQuery("CREATE TEMP TABLE upsertTable (k int PRIMARY KEY, n int, d text)");
+
+      UpsertQuery query = t.upsert("upsertTable (k, n, d)");
+
+      query.onConflict(QStringList() << "k");
+
+      //all rows are inserted
+      query.values(1, 10, "a").values(2, 20, "b").values(3, 30, "c").exec();
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM upsertTable"), 3);
+
+      //conflicting rows are replaced, new rows are inserted
+      query.values(2, 200, "bb").values(4, 40, "d").exec();
+
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM upsertTable"), 4);
+      QCOMPARE(t.scalar<int>("SELECT n FROM upsertTable WHERE k = 2"), 200);
+      QCOMPARE(t.scalar<QString>("SELECT d FROM upsertTable WHERE k = 2"), QString("bb"));
+
+      //update rules, multi-row VALUES chunks
+      UpsertQuery counters = t.upsert("upsertTable (k, n, d)");
+
+      counters.onConflict(QStringList() << "k")
+            .update("n", UpsertQuery::Increment)
+            .update("d", UpsertQuery::Keep)
+            .setBatchMode(InsertQuery::MultiRowValues, 2);
+
+      counters.values(1, 1, "x").values(3, 3, "x").values(5, 5, "x").exec();
+
+      QCOMPARE(t.scalar<int>("SELECT n FROM upsertTable WHERE k = 1"), 11);
+      QCOMPARE(t.scalar<int>("SELECT n FROM upsertTable WHERE k = 3"), 33);
+      QCOMPARE(t.scalar<int>("SELECT n FROM upsertTable WHERE k = 5"), 5);
+      QCOMPARE(t.scalar<QString>("SELECT d FROM upsertTable WHERE k = 1"), QString("a"));
+      QCOMPARE(t.scalar<QString>("SELECT d FROM upsertTable WHERE k = 5"), QString("x"));
+
+      //the chunk statements are reused
+      counters.values(1, 1, "x").values(3, 3, "x").values(5, 5, "x").exec();
+
+      QCOMPARE(t.scalar<int>("SELECT SUM(n) FROM upsertTable WHERE k IN (1, 3, 5)"), 12 + 36 + 10);
+
+      //conflicting rows are kept
+      t.upsert("upsertTable (k, n, d)").onConflict(QStringList() << "k").doNothing()
+            .values(1, 0, "y").values(6, 60, "f").exec();
+
+      QCOMPARE(t.scalar<int>("SELECT n FROM upsertTable WHERE k = 1"), 12);
+      QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM upsertTable"), 6);
+
+      t.execNonQuery("DROP TABLE upsertTable");
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestInsert::test_case8() //upsert statements of the dialects
+{
+   Database db;
+
+   UpsertQuery query = db.upsert("t (k, n, d)");
+
+   query.onConflict(QStringList() << "k").update("n", UpsertQuery::Increment);
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::PostgreSql)).sql(2),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?),(?,?,?) ON CONFLICT (k) DO UPDATE SET n = t.n + excluded.n, d = excluded.d"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::SQLite)).sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) ON CONFLICT (k) DO UPDATE SET n = t.n + excluded.n, d = excluded.d"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::MySql)).sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) ON DUPLICATE KEY UPDATE n = n + VALUES(n), d = VALUES(d)"));
+
+   //MySQL 8.0.19+ row alias
+   QCOMPARE(query.setRowAlias("new").sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) AS new ON DUPLICATE KEY UPDATE n = n + new.n, d = new.d"));
+
+   query.setRowAlias(QString());
+
+   //untyped parameter markers are rejected by SQL Server and DB2
+   QVERIFY_EXCEPTION_THROWN(query.setDialect(SqlDialect(SqlDialect::SqlServer)).sql(), DBException);
+   QVERIFY_EXCEPTION_THROWN(query.setDialect(SqlDialect(SqlDialect::Db2)).sql(), DBException);
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::Oracle)).sql(2),
+            QString("MERGE INTO t target USING (SELECT ? k, ? n, ? d FROM dual UNION ALL SELECT ? k, ? n, ? d FROM dual) source ON (target.k = source.k)"
+                    " WHEN MATCHED THEN UPDATE SET n = target.n + source.n, d = source.d"
+                    " WHEN NOT MATCHED THEN INSERT (k, n, d) VALUES (source.k, source.n, source.d)"));
+
+   query.columnType("k", "INTEGER").columnType("n", "INTEGER").columnType("d", "VARCHAR(100)");
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::SqlServer)).sql(2),
+            QString("MERGE INTO t AS target USING (VALUES (CAST(? AS INTEGER),CAST(? AS INTEGER),CAST(? AS VARCHAR(100))),"
+                    "(CAST(? AS INTEGER),CAST(? AS INTEGER),CAST(? AS VARCHAR(100)))) AS source (k, n, d) ON (target.k = source.k)"
+                    " WHEN MATCHED THEN UPDATE SET n = target.n + source.n, d = source.d"
+                    " WHEN NOT MATCHED THEN INSERT (k, n, d) VALUES (source.k, source.n, source.d);"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::Db2)).sql(),
+            QString("MERGE INTO t AS target USING (VALUES (CAST(? AS INTEGER),CAST(? AS INTEGER),CAST(? AS VARCHAR(100)))) AS source (k, n, d) ON (target.k = source.k)"
+                    " WHEN MATCHED THEN UPDATE SET n = target.n + source.n, d = source.d"
+                    " WHEN NOT MATCHED THEN INSERT (k, n, d) VALUES (source.k, source.n, source.d)"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::Oracle)).sql(),
+            QString("MERGE INTO t target USING (SELECT CAST(? AS INTEGER) k, CAST(? AS INTEGER) n, CAST(? AS VARCHAR(100)) d FROM dual) source ON (target.k = source.k)"
+                    " WHEN MATCHED THEN UPDATE SET n = target.n + source.n, d = source.d"
+                    " WHEN NOT MATCHED THEN INSERT (k, n, d) VALUES (source.k, source.n, source.d)"));
+
+   query.doNothing();
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::SQLite)).sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) ON CONFLICT (k) DO NOTHING"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::PostgreSql)).sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) ON CONFLICT (k) DO NOTHING"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::MySql)).sql(),
+            QString("INSERT INTO t (k, n, d) VALUES (?,?,?) ON DUPLICATE KEY UPDATE k = k"));
+
+   QCOMPARE(query.setDialect(SqlDialect(SqlDialect::SqlServer)).sql(),
+            QString("MERGE INTO t AS target USING (VALUES (CAST(? AS INTEGER),CAST(? AS INTEGER),CAST(? AS VARCHAR(100)))) AS source (k, n, d) ON (target.k = source.k)"
+                    " WHEN NOT MATCHED THEN INSERT (k, n, d) VALUES (source.k, source.n, source.d);"));
+
+   QVERIFY_EXCEPTION_THROWN(query.setDialect(SqlDialect(SqlDialect::Interbase)).sql(), DBException);
+
+   //no column list
+   QVERIFY_EXCEPTION_THROWN(db.upsert("t").onConflict(QStringList() << "k").sql(), DBException);
+
+   //no conflict target
+   QVERIFY_EXCEPTION_THROWN(db.upsert("t (k, n)").sql(), DBException);
+}
+
+void TestInsert::test_case9() //keys of inserted rows
+{
+   const int rowCount = 1000;
+
+   try
+   {
+      Transaction t;
+
+      t.execNonQuery("CREATE TEMP TABLE parentTable (id INTEGER PRIMARY KEY, name text)");
+      t.execNonQuery("INSERT INTO parentTable VALUES (100, 'first')");
+
+      //rowid ranges of multi-row statements
+      InsertQuery query = t.insertInto("parentTable (name)").returningIds("id");
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values(QString("row%0").arg(i));
+      }
+
+      NonQueryResult res = query.exec();
+
+      QVector<QVariant> ids = res.insertedIds();
+
+      QCOMPARE(ids.count(), rowCount);
+      QCOMPARE(ids.first().toLongLong(), 101LL);
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         QCOMPARE(t.scalar<QString>(QString("SELECT name FROM parentTable WHERE id = %0").arg(ids.at(i).toLongLong())), QString("row%0").arg(i));
+      }
+
+      //single rows and chunk remainders
+      query.setBatchMode(InsertQuery::ExecBatch, 3);
+
+      ids = query.values("a").values("b").values("c").values("d").exec().insertedIds();
+
+      QCOMPARE(ids.count(), 4);
+      QCOMPARE(t.scalar<QString>(QString("SELECT name FROM parentTable WHERE id = %0").arg(ids.at(3).toLongLong())), QString("d"));
+
+      ids = query.values("e").exec().insertedIds();
+
+      QCOMPARE(ids.count(), 1);
+      QCOMPARE(t.scalar<QString>(QString("SELECT name FROM parentTable WHERE id = %0").arg(ids.at(0).toLongLong())), QString("e"));
+
+      //explicit keys
+      ids = t.insertInto("parentTable (id, name)").returningIds("id").values(5000, "x").values(6000, "y").exec().insertedIds();
+
+      QCOMPARE(ids, QVector<QVariant>() << 5000 << 6000);
+
+      //keys are not requested
+      QVERIFY(t.insertInto("parentTable (name)").values("z").exec().insertedIds().isEmpty());
+
+      t.execNonQuery("DROP TABLE parentTable");
+   }
+   catch (const DBException &ex)
+   {
+      QFAIL(ex.lastError.text().toStdString().c_str());
+   }
+}
+
+void TestInsert::benchmark_insert() //insert throughput: single-row exec vs execBatch vs multi-row VALUES chunks
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   const int rowCount = 100000;
+
+   QElapsedTimer timer;
+
+   Transaction t;
+
+   t.execNonQuery("CREATE TEMP TABLE benchTable (a int, b int, c real, d text)");
+
+   {
+      InsertQuery query = t.insertInto("benchTable (a, b, c, d)");
+
+      timer.start();
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values(i, i, i * 0.5, "text").exec();
+      }
+
+      qDebug() << "rows:" << rowCount << "single-row exec ms:" << timer.elapsed();
+   }
+
+   t.execNonQuery("DELETE FROM benchTable");
+
+   {
+      InsertQuery query = t.insertInto("benchTable (a, b, c, d)");
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values(i, i, i * 0.5, "text");
+      }
+
+      timer.restart();
+
+      query.exec();
+
+      qDebug() << "rows:" << rowCount << "execBatch ms:" << timer.elapsed();
+   }
+
+   t.execNonQuery("DELETE FROM benchTable");
+
+   {
+      InsertQuery query = t.insertInto("benchTable (a, b, c, d)").setBatchMode(InsertQuery::MultiRowValues);
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values(i, i, i * 0.5, "text");
+      }
+
+      timer.restart();
+
+      query.exec();
+
+      qDebug() << "rows:" << rowCount << "multi-row VALUES ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM benchTable"), rowCount);
+
+   t.execNonQuery("DROP TABLE benchTable");
+}
+
+void TestInsert::benchmark_insertStream() //streaming insert: queued rows stay bounded regardless of the input size
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   const int rowCount = 1000000;
+
+   Transaction t;
+
+   t.execNonQuery("CREATE TEMP TABLE streamTable (a int, b int, c real, d text)");
+
+   InsertStream stream = t.insertStream("streamTable (a, b, c, d)", 10000);
+
+   stream.setBatchMode(InsertQuery::MultiRowValues);
+
+   qint64 maxFlushElapsed = 0;
+
+   stream.onFlush([&maxFlushElapsed](const InsertStream::FlushInfo &info)
+   {
+      maxFlushElapsed = qMax(maxFlushElapsed, info.elapsed);
+   });
+
+   QElapsedTimer timer;
+   timer.start();
+
+   for (int i = 0; i < rowCount; ++i)
+   {
+      stream.values(i, i, i * 0.5, "text");
+   }
+
+   stream.flush();
+
+   qDebug() << "rows:" << rowCount << "flushes:" << stream.flushCount() << "total ms:" << timer.elapsed()
+            << "flush ms:" << stream.totalElapsed() / 1000 << "max flush us:" << maxFlushElapsed;
+
+   QCOMPARE(stream.totalRows(), qint64(rowCount));
+   QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM streamTable"), rowCount);
+
+   t.execNonQuery("DROP TABLE streamTable");
+}
+
+void TestInsert::benchmark_fromGadgets() //bulk insert: values() per row vs fromGadgets vs fromStructs
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   const int rowCount = 200000;
+
+   QVector<Row> rows(rowCount);
+
+   for (int i = 0; i < rowCount; ++i)
+   {
+      rows[i].a = i;
+      rows[i].b = i * 2;
+      rows[i].c = i * 3;
+      rows[i].d = QString::number(i);
+   }
+
+   Transaction t;
+
+   t.execNonQuery("CREATE TEMP TABLE gadgetTable (a int, b int, c int, d text)");
+
+   QElapsedTimer timer;
+
+   {
+      InsertQuery query = t.insertInto("gadgetTable (a, b, c, d)").setBatchMode(InsertQuery::MultiRowValues);
+
+      timer.start();
+
+      for (const Row &row : rows)
+      {
+         query.values(row.a, row.b, row.c, row.d);
+      }
+
+      query.exec();
+
+      qDebug() << "rows:" << rowCount << "values() per row ms:" << timer.elapsed();
+   }
+
+   t.execNonQuery("DELETE FROM gadgetTable");
+
+   {
+      timer.restart();
+
+      t.insertInto("gadgetTable").setBatchMode(InsertQuery::MultiRowValues).fromGadgets(rows);
+
+      qDebug() << "rows:" << rowCount << "fromGadgets ms:" << timer.elapsed();
+   }
+
+   t.execNonQuery("DELETE FROM gadgetTable");
+
+   {
+      timer.restart();
+
+      t.insertInto("gadgetTable (a, b, c, d)").setBatchMode(InsertQuery::MultiRowValues)
+            .fromStructs(rows, &Row::a, &Row::b, &Row::c, &Row::d);
+
+      qDebug() << "rows:" << rowCount << "fromStructs ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(t.scalar<int>("SELECT COUNT(*) FROM gadgetTable"), rowCount);
+
+   t.execNonQuery("DROP TABLE gadgetTable");
+}
+
+void TestInsert::benchmark_upsert() //upsert: SELECT + INSERT/UPDATE per row vs UpsertQuery batch
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   const int rowCount = 50000;
+
+   Transaction t;
+
+   t.execNonQuery("CREATE TEMP TABLE upsertBench (k int PRIMARY KEY, n int)");
+
+   //half of the keys exist
+   t.execNonQuery(QString("WITH RECURSIVE cnt(x) AS (SELECT 0 UNION ALL SELECT x + 2 FROM cnt LIMIT %0) "
+                          "INSERT INTO upsertBench SELECT x, 1 FROM cnt").arg(rowCount / 2));
+
+   QElapsedTimer timer;
+
+   {
+      PreparedQuery select = t.prepare("SELECT n FROM upsertBench WHERE k = ?");
+      InsertQuery insert = t.insertInto("upsertBench (k, n)");
+
+      timer.start();
+
+      for (int k = 0; k < rowCount; ++k)
+      {
+         QueryResult &res = select.exec(k);
+
+         if (res.next())
+         {
+            t.update("upsertBench").set("n", res.value(0).toInt() + 1).where("k = ?", k);
+         }
+         else
+         {
+            insert.values(k, 1).exec();
+         }
+      }
+
+      qDebug() << "rows:" << rowCount << "SELECT + INSERT/UPDATE ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(t.scalar<int>("SELECT SUM(n) FROM upsertBench"), rowCount + rowCount / 2);
+
+   {
+      UpsertQuery upsert = t.upsert("upsertBench (k, n)");
+
+      upsert.onConflict(QStringList() << "k")
+            .update("n", UpsertQuery::Increment)
+            .setBatchMode(InsertQuery::MultiRowValues);
+
+      for (int k = 0; k < rowCount; ++k)
+      {
+         upsert.values(k, 1);
+      }
+
+      timer.restart();
+
+      upsert.exec();
+
+      qDebug() << "rows:" << rowCount << "UpsertQuery multi-row VALUES ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(t.scalar<int>("SELECT SUM(n) FROM upsertBench"), 2 * rowCount + rowCount / 2);
+
+   t.execNonQuery("DROP TABLE upsertBench");
+}
+
+void TestInsert::benchmark_insertedIds() //parent keys: per-row exec + lastInsertId vs returningIds
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   const int rowCount = 100000;
+
+   Transaction t;
+
+   t.execNonQuery("CREATE TEMP TABLE idTable (id INTEGER PRIMARY KEY, name text)");
+
+   QElapsedTimer timer;
+
+   QVector<QVariant> ids1;
+   {
+      InsertQuery query = t.insertInto("idTable (name)");
+
+      ids1.reserve(rowCount);
+
+      timer.start();
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         ids1.append(query.values("name").exec().lastInsertId());
+      }
+
+      qDebug() << "rows:" << rowCount << "per-row exec + lastInsertId ms:" << timer.elapsed();
+   }
+
+   t.execNonQuery("DELETE FROM idTable");
+
+   QVector<QVariant> ids2;
+   {
+      InsertQuery query = t.insertInto("idTable (name)").returningIds("id");
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         query.values("name");
+      }
+
+      timer.restart();
+
+      ids2 = query.exec().insertedIds();
+
+      qDebug() << "rows:" << rowCount << "returningIds ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(ids2.count(), ids1.count());
+   QCOMPARE(t.scalar<qint64>("SELECT MAX(id) FROM idTable"), ids2.last().toLongLong());
+
+   t.execNonQuery("DROP TABLE idTable");
+}
 
 QTEST_APPLESS_MAIN(TestInsert)
 
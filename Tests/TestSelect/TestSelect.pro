@@ -11,4 +11,5 @@ TEMPLATE = app
 SOURCES +=  tst_testselect.cpp
 
 HEADERS += \
-    ../Shared/Shared.h
+    ../Shared/Shared.h \
+    ../Shared/Benchmark.h
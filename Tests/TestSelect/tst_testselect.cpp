@@ -2,6 +2,7 @@
 #include <QMetaObject>
 #include "EasyQtSql.h"
 #include "../Shared/Shared.h"
+#include "../Shared/Benchmark.h"
 
 using namespace EasyQtSql;
 
@@ -52,6 +53,26 @@ private slots:
    void test_case15();
    void test_case16();
    void test_case17();
+   void test_case18();
+   void test_case19();
+   void test_case20();
+   void test_case21();
+   void test_case22();
+   void test_case23();
+   void test_case24();
+   void test_case25();
+   void test_case26();
+   void test_case27();
+   void test_case28();
+   void test_case29();
+   void test_case30();
+   void benchmark_namedValue();
+   void benchmark_fetchGadget();
+   void benchmark_fetchColumns();
+   void benchmark_rowView();
+   void benchmark_parallel();
+   void benchmark_rangePushdown();
+   void benchmark_keysetPagination();
 
 private:
 
@@ -735,6 +756,1162 @@ void TestSelect::test_case17() //fetch rows
    }
 }
 
+void TestSelect::test_case18() //named access with resolved column handles
+{
+   Transaction t;
+
+   const auto &rows = testData();
+
+   QueryResult res = t.execQuery("SELECT a, b AS Bee, c, d, a AS a FROM testTable");
+
+   //columns can be resolved before the first row is fetched
+   const QueryResult::Column colA = res.column("a");
+   const QueryResult::Column colB = res.column("bee");
+   const QueryResult::Column colD = res.column("D");
+   const QueryResult::Column colE = res.column("e");
+
+   QVERIFY(colA.isValid());
+   QCOMPARE(colA.index(), 0); //the first column of duplicated names wins
+   QCOMPARE(colB.index(), 1);
+   QCOMPARE(colD.index(), 3);
+   QVERIFY(!colE.isValid());
+   QCOMPARE(colE.name(), QString("e"));
+
+   int curRow = 0;
+
+   while (res.next())
+   {
+      const auto &rowData = rows.at(curRow);
+
+      QCOMPARE(res.value(colA).toInt(), rowData.a);
+      QCOMPARE(res.value(colB).toInt(), rowData.b);
+      QCOMPARE(res.value(colD).toString(), rowData.d);
+      QVERIFY(!res.value(colE).isValid());
+
+      QCOMPARE(res.value("Bee").toInt(), rowData.b);
+      QCOMPARE(res.value("BEE").toInt(), rowData.b);
+      QCOMPARE(res.value("C").toInt(), rowData.c);
+      QVERIFY(!res.value("e").isValid());
+
+      QCOMPARE(res.value("c"), res.unwrappedQuery().value("c"));
+
+      ++curRow;
+   }
+
+   QCOMPARE(curRow, rowCount());
+}
+
+struct TiedRow
+{
+   int a;
+   qint64 b;
+   double c;
+   QString d;
+
+   std::tuple<int&, qint64&, double&, QString&> tie()
+   {
+      return std::tie(a, b, c, d);
+   }
+};
+
+void TestSelect::test_case19() //fetchGadget/fetchObject with cached mapping plans
+{
+   Transaction t;
+
+   const auto &rows = testData();
+
+   //column subset in other order; "e" is not mapped, "A" does not match property "a"
+   QueryResult res = t.execQuery("SELECT d, c AS e, a, b AS A FROM testTable");
+
+   int curRow = 0;
+
+   while (res.next())
+   {
+      const auto &rowData = rows.at(curRow);
+
+      Row gadget;
+      gadget.b = -1;
+      gadget.c = -1;
+
+      res.fetchGadget(gadget);
+
+      QCOMPARE(gadget.a, rowData.a);
+      QCOMPARE(gadget.b, -1);
+      QCOMPARE(gadget.c, -1);
+      QCOMPARE(gadget.d, rowData.d);
+
+      //other metaobject on the same result set gets its own plan
+      TestObject object;
+      object.b = -1;
+      object.c = -1;
+
+      res.fetchObject(object);
+
+      QCOMPARE(object.a, rowData.a);
+      QCOMPARE(object.b, -1);
+      QCOMPARE(object.c, -1);
+      QCOMPARE(object.d, rowData.d);
+
+      ++curRow;
+   }
+
+   QCOMPARE(curRow, rowCount());
+}
+
+void TestSelect::test_case20() //typed fetch: get<Ts...>, fetchInto
+{
+   Transaction t;
+
+   const auto &rows = testData();
+
+   QueryResult res = t.execQuery("SELECT a, b, c, d, NULL, 2.5 FROM testTable");
+
+   int curRow = 0;
+
+   while (res.next())
+   {
+      const auto &rowData = rows.at(curRow);
+
+      const auto tuple = res.get<int, qint64, QVariant, QString>();
+
+      QCOMPARE(std::get<0>(tuple), rowData.a);
+      QCOMPARE(std::get<1>(tuple), qint64(rowData.b));
+      QCOMPARE(std::get<2>(tuple).toInt(), rowData.c);
+      QCOMPARE(std::get<3>(tuple), rowData.d);
+
+      std::tuple<int, int> pair;
+      res.fetchInto(pair);
+      QCOMPARE(std::get<0>(pair), rowData.a);
+      QCOMPARE(std::get<1>(pair), rowData.b);
+
+      int a = 0;
+      QString d;
+      QVariant null;
+      double half = 0;
+      res.fetchInto(std::tie(a, d, d, d, null, half));
+      QCOMPARE(a, rowData.a);
+      QCOMPARE(d, rowData.d);
+      QVERIFY(null.isNull());
+      QCOMPARE(half, 2.5);
+
+      Row row;
+      res.fetchInto(row, &Row::a, &Row::b, &Row::c, &Row::d);
+      QCOMPARE(row.a, rowData.a);
+      QCOMPARE(row.b, rowData.b);
+      QCOMPARE(row.c, rowData.c);
+      QCOMPARE(row.d, rowData.d);
+
+      TiedRow tied;
+      res.fetchInto(tied);
+      QCOMPARE(tied.a, rowData.a);
+      QCOMPARE(tied.b, qint64(rowData.b));
+      QCOMPARE(tied.c, double(rowData.c));
+      QCOMPARE(tied.d, rowData.d);
+
+#if __cplusplus >= 201703L
+      const auto optionals = res.get<std::optional<int>, std::optional<int>, std::optional<int>, std::optional<QString>, std::optional<int>>();
+      QCOMPARE(*std::get<0>(optionals), rowData.a);
+      QCOMPARE(*std::get<3>(optionals), rowData.d);
+      QVERIFY(!std::get<4>(optionals).has_value());
+#endif
+
+      //fetchVars(double) used to truncate the value
+      int i1, i2, i3;
+      QString s;
+      QVariant v;
+      double lastDouble = 0;
+      res.fetchVars(i1, i2, i3, s, v, lastDouble);
+      QCOMPARE(lastDouble, 2.5);
+
+      ++curRow;
+   }
+
+   QCOMPARE(curRow, rowCount());
+}
+
+void TestSelect::test_case21() //columnar batch fetch
+{
+   Transaction t;
+
+   const auto &rows = testData();
+
+   QueryResult res = t.execQuery("SELECT a, d, CAST(c AS REAL) AS c, CASE WHEN a = 4 THEN NULL ELSE d END AS n FROM testTable");
+
+   ColumnBatch batch = res.fetchColumns(2);
+
+   QCOMPARE(batch.rowCount(), 2);
+   QCOMPARE(batch.columnCount(), 4);
+   QCOMPARE(batch.indexOf("D"), 1);
+   QCOMPARE(batch.indexOf("e"), -1);
+
+   const ColumnBatch::Column &a = batch.column(0);
+   QCOMPARE(a.name(), QString("a"));
+   QCOMPARE(a.type(), ColumnBatch::Int64);
+   QCOMPARE(a.int64Values(), QVector<qint64>({rows[0].a, rows[1].a}));
+   QCOMPARE(a.nullCount(), 0);
+
+   const ColumnBatch::Column &d = batch.column(1);
+   QCOMPARE(d.type(), ColumnBatch::String);
+   QCOMPARE(d.stringOffsets(), QVector<int>({0, 1, 2}));
+   QCOMPARE(d.stringChars(), rows[0].d + rows[1].d);
+   QCOMPARE(d.string(1), rows[1].d);
+
+   const ColumnBatch::Column &c = batch.column(2);
+   QCOMPARE(c.type(), ColumnBatch::Double);
+   QCOMPARE(c.doubleValues(), QVector<double>({double(rows[0].c), double(rows[1].c)}));
+
+   const ColumnBatch::Column &n = batch.column(3);
+   QCOMPARE(n.nullCount(), 1);
+   QVERIFY(!n.isNull(0));
+   QVERIFY(n.isNull(1));
+   QCOMPARE(n.nullBitmap().first(), quint64(2));
+   QCOMPARE(n.value(0).toString(), rows[0].d);
+   QVERIFY(n.value(1).isNull());
+
+   //the buffers of the batch are reused
+   QCOMPARE(res.fetchColumns(batch, 2), 1);
+   QCOMPARE(batch.column(0).int64Values(), QVector<qint64>({rows[2].a}));
+   QCOMPARE(batch.column(1).string(0), rows[2].d);
+   QCOMPARE(batch.column(3).nullCount(), 0);
+
+   QCOMPARE(res.fetchColumns(batch, 2), 0);
+   QVERIFY(batch.isEmpty());
+
+   //SQLite dynamic typing: a text value in an INTEGER column switches the column to the variant buffer
+   t.execNonQuery("CREATE TEMP TABLE dynamicTable (a INTEGER)");
+   t.execNonQuery("INSERT INTO dynamicTable VALUES (1), ('two'), (NULL)");
+
+   QueryResult dynamic = t.execQuery("SELECT a FROM dynamicTable ORDER BY rowid");
+
+   const ColumnBatch mixedBatch = dynamic.fetchColumns(10);
+   const ColumnBatch::Column &mixed = mixedBatch.column(0);
+
+   QCOMPARE(mixed.type(), ColumnBatch::Variant);
+   QCOMPARE(mixed.count(), 3);
+   QCOMPARE(mixed.value(0).toLongLong(), 1LL);
+   QCOMPARE(mixed.value(1).toString(), QString("two"));
+   QVERIFY(mixed.isNull(2));
+
+   //a REAL value in an INTEGER column is not rounded
+   t.execNonQuery("CREATE TEMP TABLE realTable (a INTEGER)");
+   t.execNonQuery("INSERT INTO realTable VALUES (1), (1.5)");
+
+   QueryResult real = t.execQuery("SELECT a FROM realTable ORDER BY rowid");
+
+   const ColumnBatch realBatch = real.fetchColumns(10);
+   const ColumnBatch::Column &realColumn = realBatch.column(0);
+
+   QCOMPARE(realColumn.type(), ColumnBatch::Variant);
+   QCOMPARE(realColumn.value(0).toLongLong(), 1LL);
+   QCOMPARE(realColumn.value(1).toDouble(), 1.5);
+}
+
+void TestSelect::test_case22() //range-for iteration with row views
+{
+   Transaction t;
+
+   const auto &rows = testData();
+
+   QueryResult res = t.execQuery("SELECT a, b, c, d, NULL AS e FROM testTable");
+
+   const QueryResult::Column colD = res.column("d");
+
+   QVariantList list;
+   const QVariant *listData = nullptr;
+   const QVector<QVariant> *valuesBuffer = nullptr;
+
+   int curRow = 0;
+
+   for (const QueryResult::RowView &row : res)
+   {
+      const auto &rowData = rows.at(curRow);
+
+      QCOMPARE(row.count(), 5);
+      QCOMPARE(row.get<int>(0), rowData.a);
+      QCOMPARE(row.value("b").toInt(), rowData.b);
+      QCOMPARE(row.value(colD).toString(), rowData.d);
+      QVERIFY(row.isNull(4));
+      QVERIFY(!row.isNull(0));
+
+      const auto tuple = row.get<int, int, int, QString>();
+      QCOMPARE(std::get<2>(tuple), rowData.c);
+
+      const QVector<QVariant> &values = row.values();
+      QCOMPARE(values.count(), 5);
+      QCOMPARE(values.at(3).toString(), rowData.d);
+
+      const QStringList &strings = row.strings();
+      QCOMPARE(strings.at(0), QString::number(rowData.a));
+
+      //the buffers are reused for all rows
+      if (valuesBuffer)
+         QCOMPARE(&values, valuesBuffer);
+
+      valuesBuffer = &values;
+
+      row.fetchList(list);
+      QCOMPARE(list.at(1).toInt(), rowData.b);
+
+      if (listData)
+         QCOMPARE(&list.at(0), listData);
+
+      listData = &list.at(0);
+
+      ++curRow;
+   }
+
+   QCOMPARE(curRow, rowCount());
+
+   //exhausted result yields no rows
+   QVERIFY(!(res.begin() != res.end()));
+}
+
+static QString sequenceQuery(int rowCount)
+{
+   return QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                  "SELECT x AS a, 'row' || x AS d FROM cnt").arg(rowCount);
+}
+
+void TestSelect::test_case23() //Util::parallelEach
+{
+   Transaction t;
+
+   const int rowCount = 10000;
+
+   QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+   QAtomicInteger<qint64> sum;
+   QAtomicInt rows;
+   QAtomicInt errors;
+
+   const int count = Util::parallelEach(res, [&sum, &rows, &errors](const Util::RowSnapshot &row)
+   {
+      if (row.value("D").toString() != QString("row%0").arg(row.get<int>(0)))
+         errors.fetchAndAddOrdered(1);
+
+      if (row.index() + 1 != row.get<int>(0))
+         errors.fetchAndAddOrdered(1);
+
+      sum.fetchAndAddOrdered(row.get<qint64>(0));
+      rows.fetchAndAddOrdered(1);
+   }, 100);
+
+   QCOMPARE(count, rowCount);
+   QCOMPARE(rows.load(), rowCount);
+   QCOMPARE(errors.load(), 0);
+   QCOMPARE(sum.load(), qint64(rowCount) * (rowCount + 1) / 2);
+
+   //empty result
+   QueryResult empty = t.execQuery("SELECT a FROM testTable WHERE 1 = 0");
+
+   QCOMPARE(Util::parallelEach(empty, [](const Util::RowSnapshot &) {}), 0);
+}
+
+void TestSelect::test_case24() //Util::parallelMapReduce
+{
+   Transaction t;
+
+   const int rowCount = 10000;
+
+   QThreadPool pool;
+   pool.setMaxThreadCount(4);
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+      const qint64 sum = Util::parallelMapReduce(res,
+         [](const Util::RowSnapshot &row) { return row.get<qint64>(0) * 2; },
+         [](qint64 &total, qint64 value) { total += value; },
+         qint64(0), Util::UnorderedReduce, 64, &pool);
+
+      QCOMPARE(sum, qint64(rowCount) * (rowCount + 1));
+   }
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+      const QStringList ordered = Util::parallelMapReduce(res,
+         [](const Util::RowSnapshot &row) { return row.value(1).toString(); },
+         [](QStringList &list, const QString &value) { list.append(value); },
+         QStringList(), Util::OrderedReduce, 37, &pool);
+
+      QCOMPARE(ordered.count(), rowCount);
+
+      for (int i = 0; i < rowCount; ++i)
+      {
+         QCOMPARE(ordered.at(i), QString("row%0").arg(i + 1));
+      }
+   }
+}
+
+void TestSelect::test_case25() //dialect LIMIT/OFFSET rewriting
+{
+   const QString sql = "SELECT a, b FROM testTable ORDER BY a;";
+
+   QCOMPARE(SqlDialect(SqlDialect::SQLite).limitQuery(sql, 10, 20), QString("SELECT a, b FROM testTable ORDER BY a\nLIMIT 10 OFFSET 20"));
+   QCOMPARE(SqlDialect(SqlDialect::PostgreSql).limitQuery(sql, 10), QString("SELECT a, b FROM testTable ORDER BY a\nLIMIT 10"));
+   QCOMPARE(SqlDialect(SqlDialect::SqlServer).limitQuery(sql, 10, 20), QString("SELECT a, b FROM testTable ORDER BY a\nOFFSET 20 ROWS FETCH NEXT 10 ROWS ONLY"));
+   QCOMPARE(SqlDialect(SqlDialect::Oracle).limitQuery(sql, 10, 20), QString("SELECT a, b FROM testTable ORDER BY a\nOFFSET 20 ROWS FETCH NEXT 10 ROWS ONLY"));
+   QCOMPARE(SqlDialect(SqlDialect::Interbase).limitQuery(sql, 10, 20), QString("SELECT a, b FROM testTable ORDER BY a\nROWS 21 TO 30"));
+
+   //trailing line comment is dropped, so it can not swallow the clause
+   QCOMPARE(SqlDialect(SqlDialect::SQLite).limitQuery("SELECT a FROM testTable -- comment", 1), QString("SELECT a FROM testTable\nLIMIT 1"));
+
+   //keywords in literals, identifiers and subqueries are not clauses of the statement
+   QVERIFY(!SqlDialect(SqlDialect::SQLite).limitQuery("SELECT 'LIMIT' AS \"limit\" FROM (SELECT a FROM testTable LIMIT 1)", 1).isEmpty());
+
+   //the statement verb follows the WITH list
+   QCOMPARE(SqlDialect(SqlDialect::PostgreSql).limitQuery("WITH RECURSIVE s (a) AS (SELECT 1 UNION ALL SELECT a + 1 FROM s WHERE a < 5), t AS NOT MATERIALIZED (SELECT 2) SELECT a FROM s", 3),
+            QString("WITH RECURSIVE s (a) AS (SELECT 1 UNION ALL SELECT a + 1 FROM s WHERE a < 5), t AS NOT MATERIALIZED (SELECT 2) SELECT a FROM s\nLIMIT 3"));
+   QVERIFY(SqlDialect(SqlDialect::SQLite).limitQuery("WITH x AS (SELECT a FROM testTable) INSERT INTO testTable SELECT a FROM x", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::PostgreSql).limitQuery("WITH \"x\" AS (SELECT 1) DELETE FROM testTable WHERE a IN (SELECT * FROM x)", 1).isEmpty());
+
+   //the query can not be limited safely
+   QVERIFY(SqlDialect().limitQuery(sql, 10).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::SQLite).limitQuery("SELECT a FROM testTable LIMIT 5", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::SqlServer).limitQuery("SELECT TOP 5 a FROM testTable ORDER BY a", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::SqlServer).limitQuery("SELECT a FROM testTable", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::SQLite).limitQuery("PRAGMA table_info(testTable)", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::SQLite).limitQuery("SELECT 1; SELECT 2", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::PostgreSql).limitQuery("SELECT a FROM testTable ORDER BY a FOR UPDATE", 1).isEmpty());
+   QVERIFY(SqlDialect(SqlDialect::MySql).limitQuery("SELECT a FROM testTable FOR SHARE SKIP LOCKED", 1).isEmpty());
+
+   Transaction t;
+
+   QCOMPARE(SqlDialect(t.qSqlDatabase()).type(), SqlDialect::SQLite);
+}
+
+void TestSelect::test_case26() //Database::range/top/first with LIMIT/OFFSET pushdown
+{
+   Transaction t;
+
+   const int rowCount = 1000;
+   const QString sql = sequenceQuery(rowCount);
+
+   QVector<int> rows;
+
+   int count = t.range(sql, 990, 20, [&rows](const QueryResult &row)
+   {
+      rows.append(row.value(0).toInt());
+   });
+
+   QCOMPARE(count, 10);
+   QCOMPARE(rows.first(), 991);
+   QCOMPARE(rows.last(), 1000);
+
+   count = t.top(sql, 5, [](const QueryResult &row)
+   {
+      QVERIFY(row.value(0).toInt() <= 5);
+   });
+
+   QCOMPARE(count, 5);
+
+   count = t.first(sql, [](const QueryResult &row)
+   {
+      QCOMPARE(row.value(0).toInt(), 1);
+   });
+
+   QCOMPARE(count, 1);
+
+   //fallback: the query is limited already, rows are skipped on the client side
+   rows.clear();
+
+   count = t.range(sql + " LIMIT 100", 95, 10, [&rows](const QueryResult &row)
+   {
+      rows.append(row.value(0).toInt());
+   });
+
+   QCOMPARE(count, 5);
+   QCOMPARE(rows.first(), 96);
+
+   //pushdown: range runs the limited query, so the server returns the requested rows only
+   rows.clear();
+
+   QString executed;
+
+   count = t.range(sql, 500, 10, [&rows, &executed](const QueryResult &row)
+   {
+      rows.append(row.value(0).toInt());
+      executed = row.lastQuery();
+   });
+
+   QVector<int> expected;
+
+   for (int i = 501; i <= 510; ++i)
+   {
+      expected.append(i);
+   }
+
+   QCOMPARE(count, 10);
+   QCOMPARE(rows, expected);
+   QCOMPARE(executed, SqlDialect(t.qSqlDatabase()).limitQuery(sql, 10, 500));
+}
+
+void TestSelect::test_case27() //keyset pagination
+{
+   Transaction t;
+
+   const int rowCount = 1000;
+   const int pageSize = 64;
+
+   KeysetPaginator pages = t.paginate(sequenceQuery(rowCount), QStringList() << "a", pageSize);
+
+   QVector<int> rows;
+   int pageCount = 0;
+
+   while (!pages.atEnd())
+   {
+      const int count = pages.nextPage([&rows](const QueryResult &row)
+      {
+         rows.append(row.value("a").toInt());
+      });
+
+      QVERIFY(count <= pageSize);
+
+      if (count > 0)
+         ++pageCount;
+   }
+
+   QCOMPARE(pageCount, (rowCount + pageSize - 1) / pageSize);
+   QCOMPARE(rows.count(), rowCount);
+
+   for (int i = 0; i < rows.count(); ++i)
+   {
+      QCOMPARE(rows.at(i), i + 1);
+   }
+
+   QCOMPARE(pages.cursor(), QVariantList() << rowCount);
+   QCOMPARE(pages.nextPage([](const QueryResult &) { }), 0);
+
+   //descending order
+   KeysetPaginator descPages = t.paginate(sequenceQuery(rowCount), QStringList() << "a", pageSize, Qt::DescendingOrder);
+
+   rows.clear();
+
+   descPages.nextPage([&rows](const QueryResult &row)
+   {
+      rows.append(row.value(0).toInt());
+   });
+
+   descPages.nextPage([&rows](const QueryResult &row)
+   {
+      rows.append(row.value(0).toInt());
+   });
+
+   QCOMPARE(rows.count(), pageSize * 2);
+   QCOMPARE(rows.first(), rowCount);
+   QCOMPARE(rows.last(), rowCount - pageSize * 2 + 1);
+
+   //composite key, the pages do not end on a group boundary
+   const QString groupedQuery = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                                        "SELECT x % 7 AS g, x AS a FROM cnt").arg(rowCount);
+
+   KeysetPaginator groupedPages = t.paginate(groupedQuery, QStringList() << "g" << "a", 50);
+
+   QVector<QPair<int, int>> keys;
+
+   while (!groupedPages.atEnd())
+   {
+      groupedPages.nextPage([&keys](const QueryResult &row)
+      {
+         keys.append(qMakePair(row.value("g").toInt(), row.value("a").toInt()));
+      });
+   }
+
+   QCOMPARE(keys.count(), rowCount);
+
+   for (int i = 1; i < keys.count(); ++i)
+   {
+      QVERIFY(keys.at(i - 1) < keys.at(i));
+   }
+}
+
+void TestSelect::test_case28() //keyset pagination: resumable cursor token
+{
+   Transaction t;
+
+   const int rowCount = 1000;
+   const int pageSize = 100;
+
+   QString token;
+
+   {
+      KeysetPaginator pages = t.paginate(sequenceQuery(rowCount), QStringList() << "a", pageSize);
+
+      for (int i = 0; i < 3; ++i)
+      {
+         pages.nextPage([](const QueryResult &) { });
+      }
+
+      token = pages.cursorToken();
+   }
+
+   QVERIFY(!token.isEmpty());
+
+   KeysetPaginator resumed = t.paginate(sequenceQuery(rowCount), QStringList() << "a", pageSize);
+
+   QVERIFY(resumed.setCursorToken(token));
+   QCOMPARE(resumed.cursor(), QVariantList() << 3 * pageSize);
+
+   int first = 0;
+
+   const int count = resumed.nextPage([&first](const QueryResult &row)
+   {
+      if (first == 0)
+         first = row.value("a").toInt();
+   });
+
+   QCOMPARE(count, pageSize);
+   QCOMPARE(first, 3 * pageSize + 1);
+
+   //a token of another key set is rejected
+   KeysetPaginator other = t.paginate(sequenceQuery(rowCount), QStringList() << "a" << "d", pageSize);
+
+   QVERIFY(!other.setCursorToken(token));
+   QVERIFY(!other.setCursorToken("not a token"));
+   QVERIFY(other.cursor().isEmpty());
+
+   //reset starts from the first row again
+   resumed.reset();
+
+   resumed.nextPage([&first](const QueryResult &row)
+   {
+      first = row.value("a").toInt();
+   });
+
+   QCOMPARE(resumed.cursor(), QVariantList() << pageSize);
+}
+
+void TestSelect::test_case29() //read-only statement detection (PreparedQuery skips the write lock for them)
+{
+   QVERIFY(SqlDialect::isReadOnly("select a FROM testTable"));
+   QVERIFY(SqlDialect::isReadOnly("  /* report */ -- daily\nSELECT a FROM testTable;"));
+   QVERIFY(SqlDialect::isReadOnly("WITH x AS (SELECT a FROM testTable) SELECT * FROM x"));
+   QVERIFY(SqlDialect::isReadOnly("VALUES (1, 2)"));
+   QVERIFY(SqlDialect::isReadOnly("EXPLAIN QUERY PLAN SELECT a FROM testTable"));
+   QVERIFY(SqlDialect::isReadOnly("SELECT 'FOR UPDATE' AS \"into\" FROM testTable"));
+
+   QVERIFY(!SqlDialect::isReadOnly("INSERT INTO testTable VALUES (1, 2, 3, 'a')"));
+   QVERIFY(!SqlDialect::isReadOnly("WITH x AS (SELECT 1) UPDATE testTable SET a = 1"));
+   QVERIFY(!SqlDialect::isReadOnly("SELECT a FROM testTable WHERE a = 1 FOR UPDATE"));
+   QVERIFY(!SqlDialect::isReadOnly("SELECT a INTO copyTable FROM testTable"));
+   QVERIFY(!SqlDialect::isReadOnly("EXPLAIN ANALYZE DELETE FROM testTable"));
+   QVERIFY(!SqlDialect::isReadOnly("EXPLAIN (ANALYZE, BUFFERS) DELETE FROM testTable"));
+   QVERIFY(!SqlDialect::isReadOnly("SELECT 1; DELETE FROM testTable"));
+}
+
+//====================================================
+// Occupies a pool thread until released
+
+class BlockingTask : public QRunnable
+{
+public:
+   BlockingTask(QSemaphore &started, QSemaphore &release)
+      : m_started(started)
+      , m_release(release)
+   { }
+
+   void run() override
+   {
+      m_started.release();
+      m_release.acquire();
+   }
+
+private:
+   QSemaphore &m_started;
+   QSemaphore &m_release;
+};
+
+void TestSelect::test_case30() //parallel helpers: exhausted pool, exceptions thrown on the pool threads
+{
+   Transaction t;
+
+   QThreadPool pool;
+   pool.setMaxThreadCount(1);
+
+   QSemaphore started;
+   QSemaphore release;
+
+   pool.start(new BlockingTask(started, release));
+
+   started.acquire(); //the only thread of the pool is busy: the batches run on the calling thread
+
+   QAtomicInt rows;
+
+   auto countRow = [&rows](const Util::RowSnapshot &) { rows.ref(); };
+   auto mapValue = [](const Util::RowSnapshot &row) { return row.get<qint64>(0); };
+   auto sumValues = [](qint64 &total, qint64 value) { total += value; };
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(1000));
+
+      QCOMPARE(Util::parallelEach(res, countRow, 16, &pool), 1000);
+      QCOMPARE(rows.load(), 1000);
+   }
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(1000));
+
+      QCOMPARE(Util::parallelMapReduce(res, mapValue, sumValues, qint64(0), Util::OrderedReduce, 16, &pool), qint64(500500));
+   }
+
+   release.release();
+   pool.waitForDone();
+
+   pool.setMaxThreadCount(4);
+
+   auto failRow = [](const Util::RowSnapshot &row)
+   {
+      if (row.index() == 500)
+         throw std::runtime_error("map failed");
+
+      return row.get<qint64>(0);
+   };
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(1000));
+
+      QVERIFY_EXCEPTION_THROWN(Util::parallelEach(res, failRow, 16, &pool), std::runtime_error);
+   }
+
+   {
+      QueryResult res = t.execQuery(sequenceQuery(1000));
+
+      QVERIFY_EXCEPTION_THROWN(Util::parallelMapReduce(res, failRow, sumValues, qint64(0), Util::OrderedReduce, 16, &pool), std::runtime_error);
+   }
+}
+
+void TestSelect::benchmark_namedValue() //named value access: QSqlQuery scan vs hashed lookup vs resolved column
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 100000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x AS a, x * 2 AS b, x * 3 AS c, 'text' AS d, x AS e, x AS f, x AS g, x AS h FROM cnt").arg(rowCount);
+
+   QElapsedTimer timer;
+
+   qint64 sum1 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.start();
+
+      while (res.next())
+      {
+         sum1 += res.unwrappedQuery().value("h").toLongLong();
+      }
+
+      qDebug() << "QSqlQuery::value(name) ms:" << timer.elapsed();
+   }
+
+   qint64 sum2 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.restart();
+
+      while (res.next())
+      {
+         sum2 += res.value("h").toLongLong();
+      }
+
+      qDebug() << "QueryResult::value(name) ms:" << timer.elapsed();
+   }
+
+   qint64 sum3 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      const QueryResult::Column colH = res.column("h");
+
+      timer.restart();
+
+      while (res.next())
+      {
+         sum3 += res.value(colH).toLongLong();
+      }
+
+      qDebug() << "QueryResult::value(Column) ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(sum2, sum1);
+   QCOMPARE(sum3, sum1);
+}
+
+void TestSelect::benchmark_fetchGadget() //fetchGadget: cached mapping plan vs the former toMap() path
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 1000000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x AS a, x * 2 AS b, x * 3 AS c, 'text' AS d FROM cnt").arg(rowCount);
+
+   //the former fetchGadget implementation
+   auto mapFetchGadget = [](const QueryResult &res, Row &gadget)
+   {
+      const QMetaObject &metaobject = gadget.staticMetaObject;
+
+      const int count = metaobject.propertyCount();
+
+      const QVariantMap map = res.toMap();
+
+      for (int i = 0; i < count; ++i)
+      {
+         QMetaProperty metaproperty = metaobject.property(i);
+
+         if (metaproperty.isWritable())
+         {
+            QLatin1String sName(metaproperty.name());
+
+            if (map.contains(sName))
+            {
+               metaproperty.writeOnGadget(&gadget, map.value(sName));
+            }
+         }
+      }
+   };
+
+   QElapsedTimer timer;
+
+   qint64 sum1 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.start();
+
+      while (res.next())
+      {
+         Row row;
+         mapFetchGadget(res, row);
+
+         sum1 += row.a + row.b + row.c + row.d.size();
+      }
+
+      qDebug() << "rows:" << rowCount << "toMap() fetchGadget ms:" << timer.elapsed();
+   }
+
+   qint64 sum2 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.restart();
+
+      while (res.next())
+      {
+         Row row;
+         res.fetchGadget(row);
+
+         sum2 += row.a + row.b + row.c + row.d.size();
+      }
+
+      qDebug() << "rows:" << rowCount << "cached plan fetchGadget ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(sum2, sum1);
+}
+
+void TestSelect::benchmark_fetchColumns() //columnar batches vs row-wise fetchVector
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 1000000;
+   const int batchSize = 10000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x AS a, x * 0.5 AS b, 'text' AS d FROM cnt").arg(rowCount);
+
+   QElapsedTimer timer;
+
+   double sum1 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      QVector<qint64> a;
+      QVector<double> b;
+      QStringList d;
+      QVector<QVariant> row;
+
+      timer.start();
+
+      while (res.next())
+      {
+         res.fetchVector(row);
+
+         a.append(row.at(0).toLongLong());
+         b.append(row.at(1).toDouble());
+         d.append(row.at(2).toString());
+      }
+
+      for (int i = 0; i < a.count(); ++i)
+      {
+         sum1 += a[i] + b[i];
+      }
+
+      qDebug() << "rows:" << rowCount << "fetchVector + transpose ms:" << timer.elapsed();
+   }
+
+   double sum2 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      ColumnBatch batch;
+
+      timer.restart();
+
+      while (res.fetchColumns(batch, batchSize) > 0)
+      {
+         const qint64 *a = batch.column(0).int64Values().constData();
+         const double *b = batch.column(1).doubleValues().constData();
+
+         for (int i = 0; i < batch.rowCount(); ++i)
+         {
+            sum2 += a[i] + b[i];
+         }
+      }
+
+      qDebug() << "rows:" << rowCount << "fetchColumns ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(sum2, sum1);
+}
+
+void TestSelect::benchmark_rowView() //full scan: toList() per row vs range-for with reused buffers
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 1000000;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x AS a, x * 2 AS b, x * 3 AS c, 'text' AS d FROM cnt").arg(rowCount);
+
+   QElapsedTimer timer;
+
+   qint64 sum1 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.start();
+
+      while (res.next())
+      {
+         const QVariantList list = res.toList();
+
+         sum1 += list.at(0).toLongLong() + list.at(3).toString().size();
+      }
+
+      qDebug() << "rows:" << rowCount << "toList() ms:" << timer.elapsed();
+   }
+
+   qint64 sum2 = 0;
+   {
+      QueryResult res = t.execQuery(sql);
+
+      timer.restart();
+
+      for (const auto &row : res)
+      {
+         const QVector<QVariant> &values = row.values();
+
+         sum2 += values.at(0).toLongLong() + values.at(3).toString().size();
+      }
+
+      qDebug() << "rows:" << rowCount << "RowView::values() ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(sum2, sum1);
+}
+
+void TestSelect::benchmark_parallel() //Util::each vs Util::parallelEach / parallelMapReduce scaling with thread count
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 20000;
+
+   //CPU-heavy per-row work: JSON payload round trip
+   auto work = [](qint64 value)
+   {
+      QJsonObject object;
+
+      for (int i = 0; i < 20; ++i)
+      {
+         object.insert(QString("key%0").arg(i), value + i);
+      }
+
+      const QByteArray json = QJsonDocument(object).toJson(QJsonDocument::Compact);
+
+      return qint64(QJsonDocument::fromJson(json).object().value("key19").toDouble());
+   };
+
+   QElapsedTimer timer;
+
+   qint64 serialSum = 0;
+   {
+      QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+      timer.start();
+
+      Util::each(res, [&serialSum, &work](const QueryResult &row)
+      {
+         serialSum += work(row.value(0).toLongLong());
+      });
+
+      qDebug() << "rows:" << rowCount << "Util::each ms:" << timer.elapsed();
+   }
+
+   for (int threadCount = 1; threadCount <= QThread::idealThreadCount(); threadCount *= 2)
+   {
+      QThreadPool pool;
+      pool.setMaxThreadCount(threadCount);
+
+      QAtomicInteger<qint64> eachSum;
+      {
+         QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+         timer.restart();
+
+         Util::parallelEach(res, [&eachSum, &work](const Util::RowSnapshot &row)
+         {
+            eachSum.fetchAndAddRelaxed(work(row.get<qint64>(0)));
+         }, 256, &pool);
+      }
+
+      const qint64 eachTime = timer.elapsed();
+
+      qint64 mapReduceSum = 0;
+      {
+         QueryResult res = t.execQuery(sequenceQuery(rowCount));
+
+         timer.restart();
+
+         mapReduceSum = Util::parallelMapReduce(res,
+            [&work](const Util::RowSnapshot &row) { return work(row.get<qint64>(0)); },
+            [](qint64 &total, qint64 value) { total += value; },
+            qint64(0), Util::OrderedReduce, 256, &pool);
+      }
+
+      const qint64 mapReduceTime = timer.elapsed();
+
+      QCOMPARE(eachSum.load(), serialSum);
+      QCOMPARE(mapReduceSum, serialSum);
+
+      qDebug() << "threads:" << threadCount
+               << "parallelEach ms:" << eachTime
+               << "parallelMapReduce (ordered) ms:" << mapReduceTime;
+   }
+}
+
+void TestSelect::benchmark_rangePushdown() //deep page: server side LIMIT/OFFSET vs client side skipping
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 1000000;
+   const int start = rowCount - 100;
+   const int count = 50;
+
+   const QString sql = QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                               "SELECT x AS a, 'text' || x AS d FROM cnt").arg(rowCount);
+
+   QElapsedTimer timer;
+
+   qint64 sum1 = 0;
+   {
+      timer.start();
+
+      //the former Database::range implementation
+      QueryResult res = t.execQuery(sql);
+
+      Util::range(res, start, count, [&sum1](const QueryResult &row)
+      {
+         sum1 += row.value(0).toLongLong();
+      });
+
+      qDebug() << "rows transferred:" << start + count << "client side skipping ms:" << timer.elapsed();
+   }
+
+   qint64 sum2 = 0;
+   {
+      timer.restart();
+
+      const int handled = t.range(sql, start, count, [&sum2](const QueryResult &row)
+      {
+         sum2 += row.value(0).toLongLong();
+      });
+
+      qDebug() << "rows transferred:" << handled << "LIMIT/OFFSET pushdown ms:" << timer.elapsed();
+   }
+
+   QCOMPARE(sum2, sum1);
+}
+
+void TestSelect::benchmark_keysetPagination() //deep page: keyset (seek) pagination vs LIMIT/OFFSET
+{
+   SKIP_UNLESS_BENCHMARKS();
+
+   Transaction t;
+
+   const int rowCount = 500000;
+   const int pageSize = 100;
+   const int deepStart = rowCount - pageSize;
+
+   t.execNonQuery("CREATE TEMP TABLE keysetTable (id INTEGER PRIMARY KEY, d TEXT)");
+
+   t.execNonQuery(QString("WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt LIMIT %0) "
+                          "INSERT INTO keysetTable SELECT x, 'row' || x FROM cnt").arg(rowCount));
+
+   const QString sql = "SELECT id, d FROM keysetTable";
+
+   QElapsedTimer timer;
+
+   qint64 sum1 = 0, sum2 = 0;
+
+   timer.start();
+
+   t.range(sql + " ORDER BY id", deepStart, pageSize, [&sum1](const QueryResult &row)
+   {
+      sum1 += row.value(0).toLongLong();
+   });
+
+   qDebug() << "page at row" << deepStart << "LIMIT/OFFSET ms:" << timer.elapsed();
+
+   KeysetPaginator pages = t.paginate(sql, QStringList() << "id", pageSize);
+
+   timer.restart();
+
+   pages.nextPage([](const QueryResult &) { });
+
+   qDebug() << "first page keyset ms:" << timer.elapsed();
+
+   pages.setCursor(QVariantList() << deepStart);
+
+   timer.restart();
+
+   pages.nextPage([&sum2](const QueryResult &row)
+   {
+      sum2 += row.value(0).toLongLong();
+   });
+
+   qDebug() << "page at row" << deepStart << "keyset ms:" << timer.elapsed();
+
+   QCOMPARE(sum2, sum1);
+
+   t.execNonQuery("DROP TABLE keysetTable");
+}
+
 QTEST_APPLESS_MAIN(TestSelect)
 
 #include "tst_testselect.moc"
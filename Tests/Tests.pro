@@ -5,4 +5,6 @@ SUBDIRS += \
     TestSelect \
     TestDelete \
     TestInsert \
-    TestUpdate
+    TestUpdate \
+    TestFactory \
+    TestAggregate